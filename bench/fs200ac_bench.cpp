@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/AxisPipeline.hpp>
+#include <FS200AC/FrameStream.hpp>
+#include <FS200AC/VirtualClock.hpp>
+
+#include "FS200ACProtocol.hpp"
+
+using std::chrono::duration;
+
+struct Result {
+    std::string name;
+    double ns_per_op;
+    double ops_per_sec;
+};
+
+static std::vector<Result> results;
+static double min_time = 0.5;
+
+static void report(const char *name, std::size_t ops, double elapsed) {
+    Result result = {name, elapsed * 1e9 / ops, ops / elapsed};
+    printf("%-28s %14.1f ns/op %14.0f ops/s\n", name, result.ns_per_op, result.ops_per_sec);
+    results.push_back(result);
+}
+
+// runs fn (which performs ops operations per call) until min_time has passed
+template<typename F>
+void measure(const char *name, std::size_t ops, F fn) {
+    std::size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        total += ops;
+        elapsed = duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < min_time);
+    report(name, total, elapsed);
+}
+
+static volatile uint32_t sink;
+
+static std::vector<uint8_t> make_stream(std::size_t frames, bool corrupt) {
+    std::vector<uint8_t> stream;
+    uint8_t frame[9];
+    for (std::size_t i = 0; i < frames; i++) {
+        FS200ACEmulator::Frame f = {(int8_t)(i % 100), (int8_t)-(int)(i % 90), (int8_t)(i % 80),
+                                    ID_THROTTLE, {(uint8_t)(i & 0x7f), 0}};
+        encode_frame(f.roll, f.pitch, f.yaw, f.id, f.data[0], f.data[1], frame);
+        if (corrupt) {
+            frame[8] ^= 1;
+        }
+        stream.insert(stream.end(), frame, frame + sizeof(frame));
+    }
+    return stream;
+}
+
+static void bench_decoder() {
+    const std::size_t frames = 4096;
+    std::vector<uint8_t> valid = make_stream(frames, false);
+    std::vector<uint8_t> corrupt = make_stream(frames, true);
+
+    measure("decode/frame", frames, [&] {
+        FS200AC::FrameDecoder decoder;
+        FS200AC::FrameDecoder::Frame frame;
+        const uint8_t *pos = valid.data(), *end = pos + valid.size();
+        while (decoder.decode(pos, end, frame) == FS200AC::FrameDecoder::FrameReady) {
+            sink = sink + frame.event.slider;
+        }
+    });
+    measure("decode/checksum_error", frames, [&] {
+        FS200AC::FrameDecoder decoder;
+        FS200AC::FrameDecoder::Frame frame;
+        const uint8_t *pos = corrupt.data(), *end = pos + corrupt.size();
+        while (decoder.decode(pos, end, frame) != FS200AC::FrameDecoder::NeedMore) {
+            sink = sink + 1;
+        }
+    });
+}
+
+static void bench_poll() {
+    FS200ACEmulator::Options options;
+    options.synthetic = true;
+    FS200ACEmulator emulator(options);
+    FS200ACEmulator::Provider provider(emulator);
+    FS200AC fs(provider);
+    FS200AC::ControlsState controls;
+    if (!fs.initialize(controls)) {
+        fprintf(stderr, "initialize() against the emulator failed\n");
+        exit(1);
+    }
+    measure("poll/frame", 1024, [&] {
+        int8_t roll, pitch, yaw;
+        FS200AC::Event event;
+        for (int i = 0; i < 1024; i++) {
+            if (!fs.poll(roll, pitch, yaw, event)) {
+                fprintf(stderr, "poll() against the emulator failed\n");
+                exit(1);
+            }
+            sink = sink + roll;
+        }
+    });
+    FS200AC::Sample samples[256];
+    measure("poll_batch/frame", 1024, [&] {
+        std::size_t total = 0;
+        while (total < 1024) {
+            std::size_t count = fs.poll_batch(samples, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+            if (!count) {
+                fprintf(stderr, "poll_batch() against the emulator failed\n");
+                exit(1);
+            }
+            total += count;
+        }
+        sink = sink + samples[0].roll;
+    });
+}
+
+// hands out a prepared stream a frame at a time, as a serial port would
+struct MemoryTransport {
+    const uint8_t *pos;
+    const uint8_t *end;
+
+    std::size_t read_some(uint8_t *buffer, std::size_t count) {
+        std::size_t n = std::min<std::size_t>({count, 9, (std::size_t)(end - pos)});
+        memcpy(buffer, pos, n);
+        pos += n;
+        return n;
+    }
+    bool write(const uint8_t *, std::size_t) { return true; }
+};
+
+struct MemoryProvider : public FS200AC::SerialProvider {
+    MemoryTransport transport;
+
+    virtual void setReadTimeout(unsigned int, unsigned int) {}
+    virtual void setWriteTimeout(unsigned int) {}
+    virtual bool read(uint8_t *buffer, std::size_t count) { return transport.read_some(buffer, count) == count; }
+    virtual bool write(const uint8_t *buffer, std::size_t count) { return transport.write(buffer, count); }
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count) { return transport.read_some(buffer, count); }
+};
+
+static void bench_stream() {
+    const std::size_t frames = 4096;
+    std::vector<uint8_t> stream = make_stream(frames, false);
+
+    measure("stream/static", frames, [&] {
+        MemoryTransport transport = {stream.data(), stream.data() + stream.size()};
+        basic_FrameStream<MemoryTransport> frames(transport);
+        basic_FrameStream<MemoryTransport>::Frame frame;
+        while (frames.next(frame)) {
+            sink = sink + frame.roll;
+        }
+    });
+    measure("stream/virtual", frames, [&] {
+        MemoryProvider provider;
+        provider.transport = {stream.data(), stream.data() + stream.size()};
+        FrameStream frames(provider);
+        FrameStream::Frame frame;
+        while (frames.next(frame)) {
+            sink = sink + frame.roll;
+        }
+    });
+}
+
+static void bench_axes() {
+    const std::size_t frames = 4096;
+    std::vector<FS200AC::Sample> samples(frames);
+    auto now = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < frames; i++) {
+        samples[i].timestamp = now + std::chrono::milliseconds(10 * i);
+        samples[i].roll = (int8_t)(i % 200 - 100);
+        samples[i].pitch = (int8_t)(i % 150 - 75);
+        samples[i].yaw = (int8_t)(i % 50);
+    }
+    AxisPipeline pipeline;
+    AxisPipeline::AxisConfig config;
+    config.deadzone = 0.05f;
+    config.expo = 0.3f;
+    config.calibrate = true;
+    config.alpha = 0.5f;
+    config.beta = 0.1f;
+    for (int axis = 0; axis < AxisPipeline::AXES; axis++) {
+        pipeline.configure((AxisPipeline::Axis)axis, config);
+    }
+
+    // calibration settles during the first pass, later passes measure the steady state
+    measure("axes/process", frames, [&] {
+        for (auto &sample : samples) {
+            sink = sink + (pipeline.process(sample).value[0] > 0.0f);
+        }
+    });
+}
+
+static void bench_initialize(const char *name, FS200AC::Pacing pacing, FS200AC::TimeSource *time = nullptr) {
+    // only initialize() itself is timed, not the reset done by ~FS200AC()
+    std::size_t total = 0;
+    double elapsed = 0;
+    do {
+        FS200ACEmulator emulator;
+        FS200ACEmulator::Provider provider(emulator);
+        FS200AC fs(provider);
+        fs.set_pacing(pacing);
+        fs.set_time_source(time);
+        FS200AC::ControlsState controls;
+        auto start = std::chrono::steady_clock::now();
+        if (!fs.initialize(controls)) {
+            fprintf(stderr, "initialize() against the emulator failed\n");
+            exit(1);
+        }
+        elapsed += duration<double>(std::chrono::steady_clock::now() - start).count();
+        total++;
+    } while (elapsed < min_time);
+    report(name, total, elapsed);
+}
+
+static void bench_initialize() {
+    bench_initialize("initialize/fixed", FS200AC::Pacing_Fixed);
+    bench_initialize("initialize/adaptive", FS200AC::Pacing_Adaptive);
+    // Pacing and timeouts cost nothing on virtual time, leaving the handshake's
+    // own work: the reset, reading and checking the controls state, the setup.
+    VirtualClock clock;
+    bench_initialize("initialize/virtual", FS200AC::Pacing_Fixed, &clock);
+}
+
+static bool write_baseline(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "{\n  \"benchmarks\": [\n");
+    for (std::size_t i = 0; i < results.size(); i++) {
+        fprintf(f, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_sec\": %.3f}%s\n",
+                results[i].name.c_str(), results[i].ns_per_op, results[i].ops_per_sec,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+// only understands the files written by write_baseline()
+static std::map<std::string, double> read_baseline(const char *path) {
+    std::map<std::string, double> baseline;
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return baseline;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        char name[128];
+        double ns;
+        if (sscanf(line, " {\"name\": \"%127[^\"]\", \"ns_per_op\": %lf", name, &ns) == 2) {
+            baseline[name] = ns;
+        }
+    }
+    fclose(f);
+    return baseline;
+}
+
+int main(int argc, char *argv[]) {
+    const char *save = nullptr;
+    const char *compare = nullptr;
+    const char *filter = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--save") && i + 1 < argc) {
+            save = argv[++i];
+        } else if (!strcmp(argv[i], "--compare") && i + 1 < argc) {
+            compare = argv[++i];
+        } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--save <json>] [--compare <json>] [--filter <prefix>] [--min-time <s>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct {
+        const char *name;
+        void (*run)();
+    } suites[] = {
+        {"decode", bench_decoder},
+        {"poll", bench_poll},
+        {"stream", bench_stream},
+        {"axes", bench_axes},
+        {"initialize", bench_initialize},
+    };
+    for (auto &suite : suites) {
+        if (!filter || !strncmp(suite.name, filter, strlen(filter))) {
+            suite.run();
+        }
+    }
+
+    if (compare) {
+        auto baseline = read_baseline(compare);
+        printf("\ncompared to %s:\n", compare);
+        for (auto &result : results) {
+            auto it = baseline.find(result.name);
+            if (it != baseline.end()) {
+                printf("%-28s %+7.1f%%\n", result.name.c_str(),
+                       (result.ns_per_op - it->second) * 100.0 / it->second);
+            }
+        }
+    }
+    if (save && !write_baseline(save)) {
+        fprintf(stderr, "Failed to write %s\n", save);
+        return 1;
+    }
+    return 0;
+}
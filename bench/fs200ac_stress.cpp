@@ -0,0 +1,597 @@
+// Load test for the number of consoles one host can drive (Linux only). Every
+// console is an FS200ACEmulator behind a socketpair or a pty, all of them served
+// by one "farm" thread so the console side costs a single thread however many
+// there are. The host side runs the full initialize() handshake for each and
+// then streams through one of the models below; add a Model to measure another
+// way of multiplexing consoles.
+//
+// For every console count it reports delivered events/s against what the
+// consoles offered, host CPU per console (the farm's own CPU is taken out), and
+// the time from a frame's last byte going out to its ACK coming back as the
+// console sees it. A late ACK delays the console's next frame, so the first
+// count where more than --slip percent of ACKs miss --ack-deadline is reported
+// as the point where the host stops keeping up, as is the first count where the
+// consoles, held back by late ACKs, each offer that much less than they did at
+// the smallest count. That one is the baseline rather than --rate: a frame's
+// own transmit time at low baud rates already takes most of the period.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/FS200ACHub.hpp>
+#include <FS200AC/LinuxSerialProvider.hpp>
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+struct Config {
+    std::vector<std::size_t> counts;
+    std::vector<std::string> models;
+    bool pty;
+    double frame_rate;
+    unsigned int baud;
+    double duration;
+    double warmup;
+    milliseconds ack_deadline;
+    double slip_percent;
+    bool adaptive;
+};
+
+static double thread_cpu_seconds(pthread_t thread) {
+    clockid_t clock;
+    timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0.0;
+    }
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double process_cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The console side: every emulator, served from one thread. Output is written
+// when the emulator says its next byte is ready, input is handed over as soon
+// as epoll reports it, and each frame's ACK is timed against the moment the
+// frame's last byte was written.
+class ConsoleFarm {
+    public:
+    ConsoleFarm(const FS200ACEmulator::Options &options, std::size_t count, bool pty)
+        : m_running(false), m_window(0) {
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        for (std::size_t i = 0; i < count; i++) {
+            std::unique_ptr<Console> console(new Console(options));
+            int host = -1;
+            if (pty) {
+                LinuxSerialProvider::open_pty_pair(console->fd, host);
+            } else {
+                int fds[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0) {
+                    console->fd = fds[0];
+                    host = fds[1];
+                }
+            }
+            if (console->fd < 0 || host < 0) {
+                fprintf(stderr, "could only open %zu of %zu transports\n", i, count);
+                exit(1);
+            }
+            // the host side gets the same provider a real port would
+            console->host.reset(new LinuxSerialProvider(host));
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u64 = i;
+            epoll_ctl(m_epoll, EPOLL_CTL_ADD, console->fd, &ev);
+            m_consoles.push_back(std::move(console));
+        }
+    }
+
+    ~ConsoleFarm() {
+        stop();
+        for (auto &console : m_consoles) {
+            close(console->fd);
+        }
+        close(m_epoll);
+    }
+
+    FS200AC::SerialProvider &provider(std::size_t i) { return *m_consoles[i]->host; }
+    std::size_t size() const { return m_consoles.size(); }
+
+    void start() {
+        m_running.store(true);
+        m_thread = std::thread(&ConsoleFarm::run, this);
+    }
+
+    void stop() {
+        m_running.store(false);
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    double cpu_seconds() { return thread_cpu_seconds(m_thread.native_handle()); }
+
+    // starts a measurement window, dropping the ACK latencies seen so far
+    void begin_window() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latencies.clear();
+        m_unacknowledged = 0;
+        m_frames = 0;
+        m_window++;
+    }
+
+    // ACK latencies in microseconds since begin_window(), and frames that were
+    // not acknowledged before the console sent them again
+    void end_window(std::vector<uint32_t> &latencies, uint64_t &frames, uint64_t &unacknowledged) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        latencies.swap(m_latencies);
+        frames = m_frames;
+        unacknowledged = m_unacknowledged;
+    }
+
+    private:
+    struct Console {
+        explicit Console(const FS200ACEmulator::Options &options) : emulator(options), fd(-1), version(0), awaiting_ack(false) {}
+        FS200ACEmulator emulator;
+        int fd;
+        std::unique_ptr<LinuxSerialProvider> host;
+        // scans what the console writes for complete frames
+        FS200AC::FrameDecoder decoder;
+        uint64_t version;
+        bool awaiting_ack;
+        Clock::time_point frame_written;
+    };
+    struct Timer {
+        Clock::time_point when;
+        std::size_t console;
+        uint64_t version;
+        bool operator>(const Timer &other) const { return when > other.when; }
+    };
+
+    std::vector<std::unique_ptr<Console>> m_consoles;
+    int m_epoll;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+    std::mutex m_mutex;
+    std::vector<uint32_t> m_latencies;
+    uint64_t m_frames;
+    uint64_t m_unacknowledged;
+    uint64_t m_window;
+
+    void run() {
+        m_frames = m_unacknowledged = 0;
+        for (std::size_t i = 0; i < m_consoles.size(); i++) {
+            schedule(i, Clock::now());
+        }
+        epoll_event events[64];
+        uint8_t buffer[512];
+        while (m_running.load(std::memory_order_relaxed)) {
+            auto now = Clock::now();
+            while (!m_timers.empty() && m_timers.top().when <= now) {
+                Timer timer = m_timers.top();
+                m_timers.pop();
+                if (timer.version == m_consoles[timer.console]->version) {
+                    transmit(timer.console, now);
+                }
+            }
+            // epoll only has millisecond timeouts, so the last one is slept off exactly
+            int timeout = 10;
+            if (!m_timers.empty()) {
+                auto wait = m_timers.top().when - Clock::now();
+                timeout = std::clamp((int)duration_cast<milliseconds>(wait).count(), 0, timeout);
+            }
+            int count = epoll_wait(m_epoll, events, 64, timeout);
+            if (count == 0 && !m_timers.empty() && timeout < 10) {
+                std::this_thread::sleep_until(m_timers.top().when);
+            }
+            for (int e = 0; e < count; e++) {
+                std::size_t i = events[e].data.u64;
+                Console &console = *m_consoles[i];
+                ssize_t n = ::read(console.fd, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    continue;
+                }
+                auto received = Clock::now();
+                for (ssize_t b = 0; b < n; b++) {
+                    if (buffer[b] == 0x06 && console.awaiting_ack) {
+                        console.awaiting_ack = false;
+                        record(duration_cast<microseconds>(received - console.frame_written));
+                    }
+                }
+                console.emulator.receive(buffer, n);
+                transmit(i, received);
+            }
+        }
+    }
+
+    void transmit(std::size_t i, Clock::time_point now) {
+        Console &console = *m_consoles[i];
+        uint8_t buffer[512];
+        std::size_t count = console.emulator.transmit(buffer, sizeof(buffer), now);
+        if (count) {
+            // a frame is never more than one unacknowledged frame ahead, so the
+            // transport's buffer cannot fill up and short writes are not retried
+            ssize_t written = ::write(console.fd, buffer, count);
+            (void)written;
+            const uint8_t *pos = buffer, *end = buffer + count;
+            FS200AC::FrameDecoder::Frame frame;
+            while (pos != end) {
+                if (console.decoder.decode(pos, end, frame) != FS200AC::FrameDecoder::FrameReady ||
+                    console.emulator.state() != FS200ACEmulator::Streaming) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_frames++;
+                if (console.awaiting_ack) {
+                    m_unacknowledged++;
+                }
+                console.awaiting_ack = true;
+                console.frame_written = now;
+            }
+        }
+        schedule(i, now);
+    }
+
+    void schedule(std::size_t i, Clock::time_point now) {
+        Console &console = *m_consoles[i];
+        auto next = console.emulator.next_output(now);
+        if (next != Clock::time_point::max()) {
+            m_timers.push(Timer{next, i, ++console.version});
+        }
+    }
+
+    void record(microseconds latency) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latencies.push_back((uint32_t)std::min<int64_t>(latency.count(), UINT32_MAX));
+    }
+};
+
+// A way of driving the host side of every console: initialize() each one,
+// then stream until stop(), counting the samples handed to the application.
+class Model {
+    public:
+    virtual ~Model() {}
+    virtual void start(ConsoleFarm &farm, bool adaptive) = 0;
+    virtual void stop() = 0;
+    // consoles streaming, and ones whose initialize() failed
+    virtual std::size_t streaming() const = 0;
+    virtual std::size_t failed() const = 0;
+    virtual uint64_t events() const = 0;
+};
+
+// one thread per console, each blocking in poll_batch()
+class BlockingModel : public Model {
+    public:
+    virtual void start(ConsoleFarm &farm, bool adaptive) {
+        m_stopping.store(false);
+        m_streaming.store(0);
+        m_failed.store(0);
+        m_consoles.clear();
+        for (std::size_t i = 0; i < farm.size(); i++) {
+            m_consoles.emplace_back(new Console(farm.provider(i)));
+        }
+        for (auto &console : m_consoles) {
+            Console *c = console.get();
+            c->fs.set_resilient(true);
+            if (adaptive) {
+                c->fs.set_pacing(FS200AC::Pacing_Adaptive);
+            }
+            c->thread = std::thread([this, c] { run(*c); });
+        }
+    }
+
+    virtual void stop() {
+        m_stopping.store(true);
+        for (auto &console : m_consoles) {
+            console->thread.join();
+        }
+        // the destructors reset every console, one after the other
+        m_consoles.clear();
+    }
+
+    virtual std::size_t streaming() const { return m_streaming.load(); }
+    virtual std::size_t failed() const { return m_failed.load(); }
+
+    virtual uint64_t events() const {
+        uint64_t events = 0;
+        for (auto &console : m_consoles) {
+            events += console->events.load(std::memory_order_relaxed);
+        }
+        return events;
+    }
+
+    private:
+    struct Console {
+        explicit Console(FS200AC::SerialProvider &provider) : fs(provider), events(0) {}
+        FS200AC fs;
+        std::thread thread;
+        // each counter on a line of its own, they are bumped on every frame
+        alignas(64) std::atomic<uint64_t> events;
+    };
+
+    std::vector<std::unique_ptr<Console>> m_consoles;
+    std::atomic<bool> m_stopping;
+    std::atomic<std::size_t> m_streaming;
+    std::atomic<std::size_t> m_failed;
+
+    void run(Console &console) {
+        FS200AC::ControlsState controls;
+        if (!console.fs.initialize(controls)) {
+            m_failed.fetch_add(1);
+            return;
+        }
+        m_streaming.fetch_add(1);
+        FS200AC::Sample samples[16];
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            std::size_t count = console.fs.poll_batch(samples, Clock::now() + console.fs.timeouts().frame);
+            Histogram::bump(console.events, count);
+        }
+    }
+};
+
+// every console on FS200ACHub's single epoll thread, drained by one consumer
+class HubModel : public Model {
+    public:
+    HubModel() : m_events(0) {}
+
+    virtual void start(ConsoleFarm &farm, bool adaptive) {
+        m_hub.reset(new FS200ACHub(1 << 16));
+        for (std::size_t i = 0; i < farm.size(); i++) {
+            m_hub->add_console(farm.provider(i));
+            if (adaptive) {
+                m_hub->console(i).set_pacing(FS200AC::Pacing_Adaptive);
+            }
+        }
+        m_events.store(0);
+        m_stopping.store(false);
+        m_hub->start();
+        m_consumer = std::thread([this] {
+            FS200ACHub::TaggedSample samples[256];
+            while (!m_stopping.load(std::memory_order_relaxed)) {
+                std::size_t count = m_hub->pop(samples, 256);
+                Histogram::bump(m_events, count);
+                if (count == 0) {
+                    std::this_thread::sleep_for(milliseconds(1));
+                }
+            }
+        });
+    }
+
+    virtual void stop() {
+        m_stopping.store(true);
+        m_consumer.join();
+        m_hub->stop();
+        m_hub.reset();
+    }
+
+    virtual std::size_t streaming() const { return count(FS200ACHub::Streaming); }
+    virtual std::size_t failed() const { return count(FS200ACHub::Failed); }
+    virtual uint64_t events() const { return m_events.load(std::memory_order_relaxed) + m_hub->dropped(); }
+
+    private:
+    std::unique_ptr<FS200ACHub> m_hub;
+    std::thread m_consumer;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_events;
+
+    std::size_t count(FS200ACHub::Status status) const {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < m_hub->size(); i++) {
+            n += m_hub->status(i) == status;
+        }
+        return n;
+    }
+};
+
+static std::unique_ptr<Model> make_model(const std::string &name) {
+    if (name == "blocking") {
+        return std::unique_ptr<Model>(new BlockingModel());
+    }
+    if (name == "hub") {
+        return std::unique_ptr<Model>(new HubModel());
+    }
+    return nullptr;
+}
+
+struct Result {
+    std::size_t consoles;
+    std::size_t failed;
+    double initialize_s;
+    double events_per_s;
+    double offered_per_s;
+    double host_cpu_percent;
+    double farm_cpu_percent;
+    uint32_t p50, p90, p99, p999, max;
+    double late_percent;
+};
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (std::size_t)(p * sorted.size()))];
+}
+
+static Result run(const Config &config, const std::string &model_name, std::size_t consoles) {
+    FS200ACEmulator::Options options;
+    options.frame_rate = config.frame_rate;
+    options.baud = config.baud;
+    options.synthetic = true;
+    ConsoleFarm farm(options, consoles, config.pty);
+    std::unique_ptr<Model> model = make_model(model_name);
+    Result result = {};
+    result.consoles = consoles;
+
+    farm.start();
+    auto start = Clock::now();
+    model->start(farm, config.adaptive);
+    while (model->streaming() + model->failed() < consoles && Clock::now() - start < std::chrono::seconds(60)) {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    result.initialize_s = duration<double>(Clock::now() - start).count();
+    result.failed = consoles - model->streaming();
+    std::this_thread::sleep_for(duration<double>(config.warmup));
+
+    farm.begin_window();
+    uint64_t events = model->events();
+    double cpu = process_cpu_seconds();
+    double farm_cpu = farm.cpu_seconds();
+    auto window_start = Clock::now();
+    std::this_thread::sleep_for(duration<double>(config.duration));
+    double elapsed = duration<double>(Clock::now() - window_start).count();
+    events = model->events() - events;
+    farm_cpu = farm.cpu_seconds() - farm_cpu;
+    // everything but the farm thread is the host; the main thread only sleeps
+    cpu = process_cpu_seconds() - cpu - farm_cpu;
+    std::vector<uint32_t> latencies;
+    uint64_t frames, unacknowledged;
+    farm.end_window(latencies, frames, unacknowledged);
+
+    model->stop();
+    farm.stop();
+
+    result.events_per_s = events / elapsed;
+    result.offered_per_s = frames / elapsed;
+    result.host_cpu_percent = consoles ? 100.0 * cpu / elapsed / consoles : 0.0;
+    result.farm_cpu_percent = 100.0 * farm_cpu / elapsed;
+    std::sort(latencies.begin(), latencies.end());
+    result.p50 = percentile(latencies, 0.5);
+    result.p90 = percentile(latencies, 0.9);
+    result.p99 = percentile(latencies, 0.99);
+    result.p999 = percentile(latencies, 0.999);
+    result.max = latencies.empty() ? 0 : latencies.back();
+    uint64_t deadline = duration_cast<microseconds>(config.ack_deadline).count();
+    uint64_t late = unacknowledged + (latencies.end() - std::upper_bound(latencies.begin(), latencies.end(), deadline));
+    result.late_percent = frames ? 100.0 * late / frames : 0.0;
+    return result;
+}
+
+static std::vector<std::size_t> parse_counts(const char *arg) {
+    std::vector<std::size_t> counts;
+    for (const char *pos = arg; *pos;) {
+        char *end;
+        counts.push_back(strtoul(pos, &end, 10));
+        pos = *end == ',' ? end + 1 : end;
+        if (end == pos && *end) {
+            break;
+        }
+    }
+    return counts;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [--consoles <n,n,...>] [--model blocking|hub|all] [--pty] [--rate <Hz>] [--baud <bps>]\n"
+            "          [--duration <s>] [--warmup <s>] [--ack-deadline <ms>] [--slip <percent>] [--adaptive]\n",
+            name);
+}
+
+int main(int argc, char *argv[]) {
+    Config config;
+    config.counts = {1, 10, 50, 100, 200, 400};
+    config.models = {"blocking", "hub"};
+    config.pty = false;
+    config.frame_rate = 100;
+    config.baud = 9600;
+    config.duration = 3;
+    config.warmup = 0.5;
+    config.ack_deadline = milliseconds(0);
+    config.slip_percent = 1;
+    config.adaptive = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--consoles") && i + 1 < argc) {
+            config.counts = parse_counts(argv[++i]);
+        } else if (!strcmp(argv[i], "--model") && i + 1 < argc) {
+            std::string model = argv[++i];
+            config.models = model == "all" ? std::vector<std::string>{"blocking", "hub"} : std::vector<std::string>{model};
+        } else if (!strcmp(argv[i], "--pty")) {
+            config.pty = true;
+        } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            config.frame_rate = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+            config.baud = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            config.duration = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+            config.warmup = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--ack-deadline") && i + 1 < argc) {
+            config.ack_deadline = milliseconds(atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--slip") && i + 1 < argc) {
+            config.slip_percent = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--adaptive")) {
+            config.adaptive = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (const std::string &model : config.models) {
+        if (!make_model(model)) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // an ACK later than the frame period holds the console's next frame back
+    if (config.ack_deadline.count() == 0) {
+        config.ack_deadline = milliseconds(config.frame_rate > 0 ? (int)(1000 / config.frame_rate) : 10);
+    }
+    // each console takes two to four descriptors
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    printf("%s transport, %.0f frames/s per console at %u baud, ACK deadline %lld ms, %u cores\n",
+           config.pty ? "pty" : "socketpair", config.frame_rate, config.baud, (long long)config.ack_deadline.count(),
+           std::thread::hardware_concurrency());
+    for (const std::string &model : config.models) {
+        printf("\n%-8s %8s %6s %7s %11s %11s %9s %8s %8s %8s %8s %8s %8s %7s\n", "model", "consoles", "failed", "init s",
+               "events/s", "offered/s", "cpu/seat%", "farm%", "ack p50", "p90", "p99", "p99.9", "max us", "late%");
+        std::size_t slipped = 0;
+        double baseline = 0.0;
+        for (std::size_t consoles : config.counts) {
+            Result r = run(config, model, consoles);
+            printf("%-8s %8zu %6zu %7.2f %11.0f %11.0f %9.3f %8.1f %8u %8u %8u %8u %8u %7.2f\n", model.c_str(), r.consoles,
+                   r.failed, r.initialize_s, r.events_per_s, r.offered_per_s, r.host_cpu_percent, r.farm_cpu_percent, r.p50,
+                   r.p90, r.p99, r.p999, r.max, r.late_percent);
+            fflush(stdout);
+            double per_console = consoles ? r.offered_per_s / consoles : 0.0;
+            baseline = baseline > 0.0 ? baseline : per_console;
+            double shortfall = baseline > 0.0 ? 100.0 * (1.0 - per_console / baseline) : 0.0;
+            if (!slipped && (r.late_percent > config.slip_percent || shortfall > config.slip_percent || r.failed)) {
+                slipped = consoles;
+            }
+        }
+        if (slipped) {
+            printf("%s: stops keeping up at %zu consoles (late ACKs, fewer frames per console or failed initialize)\n", model.c_str(), slipped);
+        } else {
+            printf("%s: no slip up to %zu consoles\n", model.c_str(), config.counts.empty() ? 0 : config.counts.back());
+        }
+    }
+    return 0;
+}
@@ -1,15 +1,23 @@
 #include <cstdio>
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <string>
 
 #include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACCapture.hpp>
+#include <FS200AC/FS200ACTrace.hpp>
 #include <serial/serial.h>
 
-const char *control_name(FS200AC::Control control);
+static const char *control_name(FS200AC::Control control) {
+    return FS200AC::control_name(control);
+}
 
 FS200AC::Radio current_radio = FS200AC::Radio_NAV1;
 
 class SerialProvider : public FS200AC::SerialProvider {
     public:
-    SerialProvider(serial::Serial &serial) : m_serial(serial) {
+    SerialProvider(serial::Serial &serial) : m_serial(serial), m_port(serial.getPort()), m_connected(true) {
         // 9600 8N1
         serial.setBaudrate(9600);
         serial.setRTS(false);
@@ -18,12 +26,42 @@ class SerialProvider : public FS200AC::SerialProvider {
         serial.setStopbits(serial::stopbits_one);
     }
 
+    // the serial library throws once the device is gone, which connected() reports
     virtual bool read(uint8_t *buffer, std::size_t count) {
-        return m_serial.read(buffer, count) == count;
+        try {
+            return m_serial.read(buffer, count) == count;
+        } catch (const std::exception &) {
+            m_connected = false;
+            return false;
+        }
+    }
+
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count) {
+        try {
+            // block for the first byte, then take whatever else is already waiting
+            std::size_t n = std::min(std::max<std::size_t>(m_serial.available(), 1), count);
+            return m_serial.read(buffer, n);
+        } catch (const std::exception &) {
+            m_connected = false;
+            return 0;
+        }
     }
 
     virtual bool write(const uint8_t *buffer, std::size_t count) {
-        return m_serial.write(buffer, count) == count;
+        try {
+            return m_serial.write(buffer, count) == count;
+        } catch (const std::exception &) {
+            m_connected = false;
+            return false;
+        }
+    }
+
+    virtual bool connected() {
+        return m_connected && m_serial.isOpen();
+    }
+
+    virtual const char *port_name() {
+        return m_port.c_str();
     }
 
     virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) {
@@ -40,6 +78,8 @@ class SerialProvider : public FS200AC::SerialProvider {
     }
     private:
     serial::Serial &m_serial;
+    std::string m_port;
+    bool m_connected;
 };
 
 bool handle_button(FS200AC::Control control) {
@@ -155,14 +195,64 @@ bool handle_event(const FS200AC::Event &event) {
     return false;
 }
 
+void print_stats(const FS200AC &fs, const FS200ACTrace *trace) {
+    FS200AC::Stats stats = fs.stats();
+    fprintf(stderr, "%llu frames at %.1f/s, %llu checksum errors, %llu partial frames, %llu resync bytes\n",
+            (unsigned long long)stats.frames, stats.frame_rate(), (unsigned long long)stats.checksum_errors,
+            (unsigned long long)stats.partial_frames, (unsigned long long)stats.resync_bytes);
+    fprintf(stderr, "delivery p50 %llu us p99 %llu us, ACK write p99 %llu us\n",
+            (unsigned long long)stats.delivery.percentile_us(0.5), (unsigned long long)stats.delivery.percentile_us(0.99),
+            (unsigned long long)stats.ack_write.percentile_us(0.99));
+    const FS200AC::Timeouts &timeouts = fs.timeouts();
+    fprintf(stderr, "frame turnaround p99 %llu us, timeouts frame %lld ms command %lld ms response %lld ms\n",
+            (unsigned long long)stats.turnaround.percentile_us(0.99), (long long)timeouts.frame.count(),
+            (long long)timeouts.command.count(), (long long)timeouts.response.count());
+    if (trace) {
+        fprintf(stderr, "trace: %llu entries written, %llu dropped\n",
+                (unsigned long long)trace->written(), (unsigned long long)trace->dropped());
+    }
+}
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <serial port>\n", argv[0]);
+    // --trace logs every frame, write and error from a background thread instead
+    // of printing events from the polling thread, --trace=raw adds the bytes read
+    std::unique_ptr<FS200ACTrace> trace;
+    int arg = 1;
+    if (arg < argc && argv[arg][0] == '-') {
+        std::string option(argv[arg++]);
+        if (option == "--trace" || option == "--trace=raw") {
+            trace.reset(new FS200ACTrace(stdout));
+            if (option == "--trace=raw") {
+                trace->set_kinds(~0u);
+            }
+        } else {
+            // an unknown option, not a port name: print the usage
+            arg = argc;
+        }
+    }
+    if (argc - arg != 1 && argc - arg != 2) {
+        fprintf(stderr, "Usage: %s [--trace[=raw]] <serial port> [capture file]\n", argv[0]);
         return 1;
     }
-    serial::Serial serial(argv[1]);
+    const char *port = argv[arg];
+    const char *capture_path = arg + 1 < argc ? argv[arg + 1] : nullptr;
+    serial::Serial serial(port);
     SerialProvider provider(serial);
-    FS200AC fs(provider);
+    std::unique_ptr<CaptureProvider> capture;
+    if (capture_path) {
+        capture.reset(new CaptureProvider(provider, capture_path));
+        if (!capture->is_open()) {
+            fprintf(stderr, "Failed to open %s\n", capture_path);
+            return 1;
+        }
+    }
+    FS200AC fs(capture ? (FS200AC::SerialProvider&)*capture : provider);
+    fs.set_pacing(FS200AC::Pacing_Adaptive);
+    fs.set_resilient(true);
+    if (trace) {
+        trace->start();
+        fs.set_trace(trace.get());
+    }
     FS200AC::ControlsState controls;
     if (!fs.initialize(controls)) {
         fprintf(stderr, "Failed to initialize console\n");
@@ -180,16 +270,38 @@ int main(int argc, char *argv[]) {
     printf("PROP RPM: %d\n", controls.prop_rpm);
     printf("MIXTURE: %d\n", controls.fuel_mixture);
     printf("Version: %d.%d\n", controls.major_version, controls.minor_version);
+    const FS200AC::InitializeTimings &timings = fs.initialize_timings();
+    printf("Initialized in %lld ms (reset %lld, controls %lld, setup %lld), command byte gap %u ms\n",
+           (long long)timings.total.count() / 1000, (long long)timings.reset.count() / 1000,
+           (long long)timings.controls.count() / 1000, (long long)timings.setup.count() / 1000,
+           fs.command_byte_gap());
 
     bool done = false;
     FS200AC::Event event;
+    // frame timeouts in a row, a console that stays silent this long is given up on
+    int silent = 0;
+    const int MAX_SILENT = 50;
     while (!done) {
         int8_t roll, pitch, yaw;
         if (!fs.poll(roll, pitch, yaw, event)) {
+            // line noise and quiet periods are recovered from, a dead port is not
+            FS200AC::Error error = fs.last_error();
+            silent = error == FS200AC::Error_Timeout ? silent + 1 : 0;
+            if (error != FS200AC::Error_Write && error != FS200AC::Error_LinkLost && silent < MAX_SILENT) {
+                continue;
+            }
+            fprintf(stderr, "%s\n", silent >= MAX_SILENT ? "Console stopped sending frames" : "Lost the serial port");
+            print_stats(fs, trace.get());
             return 1;
         }
-        done = !handle_event(event);
+        silent = 0;
+        if (trace) {
+            done = event.type == FS200AC::Button && event.control == FS200AC::RMI;
+        } else {
+            done = !handle_event(event);
+        }
     }
+    print_stats(fs, trace.get());
     return 0;
 }
 
@@ -0,0 +1,80 @@
+#ifndef FS200AC_AXISPIPELINE_HPP
+#define FS200AC_AXISPIPELINE_HPP
+
+#include <chrono>
+
+#include "FS200AC.hpp"
+
+// Conditions the raw yoke axes of each Sample: calibration, deadzone and
+// response curve are folded into a 256-entry table per axis, followed by an
+// alpha-beta filter run over all three axes at once. The filter's rate estimate
+// also drives predict(), which extrapolates to the time a value will be shown
+// and so hides the ~1 ms per byte a 9600 baud frame spends on the wire.
+class AxisPipeline {
+    public:
+    enum Axis {
+        Axis_Roll,
+        Axis_Pitch,
+        Axis_Yaw,
+        AXES,
+    };
+
+    struct AxisConfig {
+        // fraction of full scale around the center that reads as 0
+        float deadzone;
+        // 0 is linear, 1 is fully cubic
+        float expo;
+        bool invert;
+        // scale by the extremes seen so far instead of the nominal +-127
+        bool calibrate;
+        // filter gains: alpha 1 and beta 0 pass values through, beta 0 alone
+        // is a plain low-pass filter
+        float alpha;
+        float beta;
+
+        AxisConfig();
+    };
+
+    struct Output {
+        std::chrono::steady_clock::time_point timestamp;
+        // -1 to 1
+        float value[AXES];
+        // full scales per second
+        float rate[AXES];
+    };
+
+    AxisPipeline();
+
+    void configure(Axis axis, const AxisConfig &config);
+    const AxisConfig &config(Axis axis) const { return m_config[axis]; }
+    // how far predict() will extrapolate at most
+    void set_max_prediction(std::chrono::microseconds horizon) { m_max_prediction = horizon; }
+
+    // call once per frame
+    const Output &process(const FS200AC::Sample &sample);
+    const Output &output() const { return m_output; }
+    // the filtered values extrapolated to when they will be used, clamped to -1 to 1
+    void predict(std::chrono::steady_clock::time_point at, float values[AXES]) const;
+    // forgets filter state and calibration
+    void reset();
+
+    private:
+    // padded to four lanes so the per-axis loops vectorize
+    static constexpr int LANES = 4;
+
+    AxisConfig m_config[AXES];
+    float m_table[AXES][256];
+    int m_min[AXES];
+    int m_max[AXES];
+    alignas(16) float m_alpha[LANES];
+    alignas(16) float m_beta[LANES];
+    alignas(16) float m_value[LANES];
+    alignas(16) float m_rate[LANES];
+    bool m_primed;
+    std::chrono::microseconds m_max_prediction;
+    Output m_output;
+
+    void build_table(int axis);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FS200AC_EPOLLREACTOR_HPP
+#define FS200AC_EPOLLREACTOR_HPP
+
+#include <map>
+#include <set>
+
+#include "FS200ACAsync.hpp"
+
+// Single-threaded Reactor built on epoll (Linux only). The owner drives it by
+// calling run_once() from its event loop; the epoll fd itself can be nested
+// into another loop through native_handle().
+class EpollReactor : public Reactor {
+    public:
+    EpollReactor();
+    ~EpollReactor();
+    EpollReactor(const EpollReactor&) = delete;
+    EpollReactor &operator=(const EpollReactor&) = delete;
+
+    void wait_readable(int fd, TimePoint deadline, std::coroutine_handle<> handle, bool *readable) override;
+    void wait_until(TimePoint deadline, std::coroutine_handle<> handle) override;
+    // stops watching fd, must be called before the fd is closed
+    void remove(int fd);
+
+    // waits up to max_wait for readiness or a timer and resumes whatever became
+    // runnable; returns false if nothing is waiting on the reactor
+    bool run_once(std::chrono::milliseconds max_wait = std::chrono::milliseconds(1000));
+    bool empty() const { return m_timers.empty(); }
+    int native_handle() const { return m_epoll; }
+
+    private:
+    struct Waiter {
+        // -1 for plain timers
+        int fd;
+        std::coroutine_handle<> handle;
+        bool *readable;
+    };
+    typedef std::multimap<TimePoint, Waiter> Timers;
+
+    int m_epoll;
+    std::set<int> m_registered;
+    // every waiter has a deadline, readers also appear in m_readers
+    Timers m_timers;
+    std::map<int, Timers::iterator> m_readers;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef FS200AC_EVENTQUEUE_HPP
+#define FS200AC_EVENTQUEUE_HPP
+
+#include <chrono>
+#include <vector>
+
+#include "FS200AC.hpp"
+
+// Bounded queue of console events that coalesces bursts according to a policy
+// per EventType, for consumers that can fall behind the console. Discrete
+// inputs stay in order: a KeepAll event also stops later values of any control
+// from being merged into entries queued before it. Single threaded; feed it
+// from poll() or pop_samples().
+class EventQueue {
+    public:
+    enum Policy {
+        // every event is queued
+        Policy_KeepAll,
+        // a pending entry for the same control is overwritten with the new value
+        Policy_LatestPerControl,
+        // as above, and the entry also sums the changes in value it absorbed
+        Policy_AccumulateDelta,
+    };
+
+    struct Entry {
+        // of the latest event merged into the entry
+        std::chrono::steady_clock::time_point timestamp;
+        FS200AC::Event event;
+        // change since the value before this entry, for Policy_AccumulateDelta
+        int32_t delta;
+        // events merged into this one, 1 if none
+        uint32_t count;
+    };
+
+    // sliders and knobs keep their latest value, everything else is kept
+    explicit EventQueue(std::size_t capacity = 256);
+
+    void set_policy(FS200AC::EventType type, Policy policy);
+    Policy policy(FS200AC::EventType type) const { return m_policies[type]; }
+    // Values of a control that wraps around after range, such as a heading that
+    // goes from 359 to 0; its deltas take the short way round. The course and
+    // heading knobs are 360, other controls 0, which does not wrap.
+    void set_range(FS200AC::Control control, int32_t range) { m_range[control & (CONTROLS - 1)] = range; }
+
+    // events of type None are ignored; returns false if the queue was full
+    bool push(const FS200AC::Event &event, std::chrono::steady_clock::time_point timestamp);
+    bool push(const FS200AC::Sample &sample) { return push(sample.event, sample.timestamp); }
+    bool pop(Entry &entry);
+    void clear();
+
+    std::size_t size() const { return (std::size_t)(m_tail - m_head); }
+    std::size_t capacity() const { return m_entries.size(); }
+    // events lost to a full queue, and events merged into a pending entry
+    uint64_t dropped() const { return m_dropped; }
+    uint64_t coalesced() const { return m_coalesced; }
+
+    private:
+    static constexpr std::size_t CONTROLS = 128;
+    static constexpr std::size_t POLICIES = FS200AC::Knob + 1;
+
+    std::vector<Entry> m_entries;
+    Policy m_policies[POLICIES];
+    // positions count up forever, the ring index is position % capacity
+    uint64_t m_head;
+    uint64_t m_tail;
+    // entries before this position can no longer be merged into
+    uint64_t m_seal;
+    // position + 1 of each control's latest entry, 0 if none
+    uint64_t m_pending[CONTROLS];
+    // of the latest event queued or merged
+    int32_t m_last_value[CONTROLS];
+    bool m_has_value[CONTROLS];
+    int32_t m_range[CONTROLS];
+    uint64_t m_dropped;
+    uint64_t m_coalesced;
+
+    static int32_t value_of(const FS200AC::Event &event);
+};
+
+#endif
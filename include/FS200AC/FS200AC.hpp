@@ -3,28 +3,227 @@
 
 #include <utility>
 #include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+
+#include "SPSCRing.hpp"
+#include "Seqlock.hpp"
+#include "Histogram.hpp"
+#include "FS200ACAsync.hpp"
+
+class FS200ACTrace;
 
 class FS200AC {
     public:
     class SerialProvider {
         public:
+            virtual ~SerialProvider() {}
             virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) = 0;
             virtual void setWriteTimeout(unsigned int multiplier) = 0;
             virtual bool read(uint8_t *buffer, std::size_t count) = 0;
             virtual bool write(const uint8_t *buffer, std::size_t count) = 0;
+            // reads up to count bytes, returning as soon as any are available
+            virtual std::size_t read_some(uint8_t *buffer, std::size_t) {
+                return read(buffer, 1) ? 1 : 0;
+            }
+            // writes what the port takes without waiting for it to drain, returning
+            // how many bytes that was; the async API retries the rest on its reactor
+            virtual std::size_t write_some(const uint8_t *buffer, std::size_t count) {
+                return write(buffer, count) ? count : 0;
+            }
+            // zero-copy read_some for providers that already hold the data in memory:
+            // the bytes stay valid until the next read, nullptr means unsupported or that
+            // read_some() answers this time (a replay that has run out)
+            virtual const uint8_t *read_view(std::size_t &count) {
+                count = 0;
+                return nullptr;
+            }
+            // fd that becomes readable when data arrives, used by the async API
+            virtual int native_handle() { return -1; }
+            // identifies the port for per-port caches, nullptr disables caching
+            virtual const char *port_name() { return nullptr; }
+            // false once the port itself is gone (device unplugged, adapter
+            // re-enumerated) and nothing more can arrive until it is reopened
+            virtual bool connected() { return true; }
     };
+    // the host's answer to a frame and the console's to a command or setup packet
+    static constexpr uint8_t CODE_ACKNOWLEDGE = 0x06;
+    // sent once on power up
+    static constexpr uint8_t CODE_BANNER = 'X';
     struct ConsoleState;
     struct ControlsState;
     struct Event;
+    struct Sample;
+    struct LiveState;
+    struct Stats;
 
     #include "internal/FS200ACControls.hpp"
 
+    // name of the enumerator, nullptr if control is not one
+    static const char *control_name(Control control);
+
     FS200AC(SerialProvider &serial);
     ~FS200AC();
     bool initialize(ControlsState &controls, const ConsoleState &initial_state = DEFAULT_INITIAL_STATE);
     bool poll(int8_t &roll, int8_t &pitch, int8_t &yaw, Event &event);
+    // Picks the console up again after it rebooted, stalled or its link was lost
+    // and reopened behind the same provider. One that kept power and setup just
+    // carries on streaming. Otherwise it is set up again with the ConsoleState it
+    // last had rather than the defaults, skipping the reset if it has announced
+    // itself. Returns false if it does not answer; needs an earlier initialize().
+    // A console that fails this probe gets the full initialize(), whose failures
+    // assert outside resilient mode as they always have.
+    bool reattach();
+    // the destructor resets the console unless this is cleared, e.g. because the link is gone
+    void set_reset_on_destroy(bool reset) { m_reset_on_destroy = reset; }
+    // Decodes and acknowledges every frame that is already buffered, up to out.size().
+    // Waits until deadline only if nothing has arrived yet. Returns the number of samples.
+    std::size_t poll_batch(std::span<Sample> out, std::chrono::steady_clock::time_point deadline);
+
+    enum Error {
+        Error_None,
+        // no frame arrived in time
+        Error_Timeout,
+        Error_Checksum,
+        // a frame started but stopped arriving
+        Error_PartialFrame,
+        Error_Write,
+        // initialize() phases
+        Error_Reset,
+        Error_Controls,
+        Error_Setup,
+        // the port is gone, see SerialProvider::connected()
+        Error_LinkLost,
+        // the console sent its boot banner instead of the next frame
+        Error_Rebooted,
+    };
+    // In resilient mode failures are only reported through last_error() and
+    // stats(), and poll() skips frames with bad checksums and drops frames that
+    // stall, looking for the next one until its timeout runs out. Otherwise a
+    // failed handshake asserts and poll() gives up on the first bad frame.
+    void set_resilient(bool resilient) { m_resilient = resilient; }
+    bool resilient() const { return m_resilient; }
+    Error last_error() const { return m_last_error.load(std::memory_order_relaxed); }
+
+    // Acquisition mode: a reader thread decodes and acknowledges frames as soon as
+    // they arrive and queues them as timestamped samples. poll() must not be
+    // called while it is running. Samples are dropped (and counted) if the queue fills.
+    bool start_acquisition(std::size_t capacity = 1024);
+    void stop_acquisition();
+    bool acquiring() const { return m_acquiring.load(std::memory_order_relaxed); }
+    bool pop_sample(Sample &sample);
+    std::size_t pop_samples(Sample *samples, std::size_t count);
+    std::size_t dropped_samples() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Sends a new ConsoleState to a streaming console without initializing again.
+    // Safe from any thread: the packet goes out from whichever thread is polling,
+    // right after it acknowledges a frame, so input keeps flowing. Nothing is sent
+    // if the console already has this state. Returns false before initialize().
+    bool update_console(const ConsoleState &state);
+    // an update is queued or waiting for the console to acknowledge it
+    bool console_update_pending() const;
+    // Queues a console command, e.g. one this class has no wrapper for, without
+    // blocking input. Safe from any thread. The polling thread writes its bytes
+    // one per acknowledged frame, never closer than the command byte gap, and
+    // resends it up to twice if the console does not acknowledge it. Frame ACKs
+    // always go out first; a pending update_console() is sent ahead of queued
+    // commands. Returns false before initialize() or while the queue is full.
+    bool queue_command(uint8_t command);
+    // queued commands, including the one being sent
+    std::size_t commands_pending() const { return m_commands_pending.load(std::memory_order_relaxed); }
+
+    enum Pacing {
+        // 42 ms between command bytes
+        Pacing_Fixed,
+        // probes for the shortest gap the console acknowledges and caches it per port,
+        // backing off towards 42 ms whenever an acknowledgement is missed
+        Pacing_Adaptive
+    };
+    void set_pacing(Pacing pacing);
+    unsigned int command_byte_gap() const { return m_byte_gap; }
+
+    // How long the protocol waits on the console. Zero fields are measured on the
+    // link: twice the 99th percentile of the turnaround seen so far plus a margin,
+    // starting from the old fixed values until a few samples are in. Non-zero
+    // fields are used as given.
+    struct Timeouts {
+        // poll() and friends, from acknowledging a frame to the next one arriving
+        std::chrono::milliseconds frame;
+        // acknowledgement of a command byte sequence
+        std::chrono::milliseconds command;
+        // listening for a boot banner before resetting the console
+        std::chrono::milliseconds banner;
+        // the console answering a handshake step or a console update
+        std::chrono::milliseconds response;
+        // from the reset commands to the banner
+        std::chrono::milliseconds reset;
+    };
+    void set_timeouts(const Timeouts &timeouts);
+    // the timeouts in effect, from the polling thread or while nothing is polling
+    const Timeouts &timeouts() const { return m_timeouts; }
+
+    struct InitializeTimings {
+        std::chrono::microseconds reset, controls, setup, total;
+    };
+    // phase durations of the last initialize()/initialize_async()
+    const InitializeTimings &initialize_timings() const { return m_timings; }
+
+    // Consistent copy of the console state as of the latest decoded frame. Safe to
+    // call from any number of threads while another one polls.
+    LiveState live_state() const;
+    uint64_t live_version() const { return m_live_published.version(); }
+
+    // Receives every frame from the polling thread once the live state has been
+    // updated, e.g. to publish them elsewhere. Keep it short: it delays the next read.
+    class SampleSink {
+        public:
+            virtual ~SampleSink() {}
+            virtual void on_sample(const Sample &sample, const LiveState &live) = 0;
+    };
+    // nullptr removes the sink; only change it while nothing is polling
+    void set_sample_sink(SampleSink *sink) { m_sink = sink; }
+
+    // Records frames, writes, errors and optionally raw reads into trace, which
+    // formats them on a thread of its own. nullptr stops tracing; only change it
+    // while nothing is polling. The destructor's reset is traced too, so remove a
+    // trace that does not outlive this object.
+    void set_trace(FS200ACTrace *trace) { m_trace = trace; }
+
+    // Where the blocking API reads the time and waits: timeouts, command pacing and
+    // sample timestamps. steady_clock unless replaced, e.g. by a VirtualClock to
+    // step through timeouts deterministically. The async API keeps the reactor's clock.
+    class TimeSource {
+        public:
+            virtual ~TimeSource() {}
+            virtual std::chrono::steady_clock::time_point now() = 0;
+            virtual void sleep_until(std::chrono::steady_clock::time_point time) = 0;
+            void sleep_for(std::chrono::steady_clock::duration duration) { sleep_until(now() + duration); }
+            static TimeSource &steady();
+    };
+    // nullptr restores steady_clock; only change it while nothing is polling
+    void set_time_source(TimeSource *time) { m_time = time ? time : &TimeSource::steady(); }
+
+    // Counters and latency histograms, always collected. Safe to call from any
+    // thread; diff two snapshots to look at an interval.
+    Stats stats() const;
 
-    enum EventType {
+    // Awaitable versions of initialize() and poll() that suspend on reactor instead
+    // of blocking. Providers without a native handle are polled every millisecond.
+    Task<bool> initialize_async(Reactor &reactor, ControlsState &controls, const ConsoleState &initial_state = DEFAULT_INITIAL_STATE);
+    Task<bool> poll_async(Reactor &reactor, Sample &sample);
+    // yields every frame received until the generator is destroyed or the link
+    // is lost, when it finishes with last_error() set to Error_LinkLost
+    AsyncGenerator<Sample> poll_stream(Reactor &reactor);
+    // resets the console without blocking, the destructor then skips its own reset
+    Task<bool> shutdown_async(Reactor &reactor);
+
+    enum EventType : uint8_t {
         None,
         Button,
         Slider,
@@ -80,22 +279,324 @@ class FS200AC {
     #endif
     ;
 
+    // resumable decoder for the 0xa5-prefixed input frames
+    class FrameDecoder {
+        public:
+        enum Status {
+            NeedMore,
+            FrameReady,
+            ChecksumError,
+        };
+        struct Frame {
+            int8_t roll, pitch, yaw;
+            Event event;
+        };
+
+        FrameDecoder();
+        // Consumes bytes from [pos, end) until a frame completes or the input runs
+        // out. Defined below, so that a transport's read loop inlines with it.
+        Status decode(const uint8_t *&pos, const uint8_t *end, Frame &frame);
+        bool in_frame() const { return m_in_frame; }
+        // frames whose ID is not in the protocol table, decoded as EventType None
+        uint32_t unknown_events() const { return m_unknown_events; }
+        // bytes discarded while not inside a frame
+        uint32_t skipped_bytes() const { return m_skipped_bytes; }
+        // acknowledgements the console sent between frames
+        uint32_t acknowledgements() const { return m_acknowledgements; }
+        // bad frames that turned out to hold the start of the next one
+        uint32_t restarts() const { return m_restarts; }
+        // a boot banner arrived after the last complete frame
+        bool banner_pending() const { return m_banner; }
+        // the 8 bytes after the start byte of the frame decode() last returned
+        const uint8_t *frame_data() const { return m_buffer; }
+        void reset();
+
+        private:
+        uint8_t m_buffer[8];
+        uint8_t m_count;
+        uint8_t m_ck;
+        bool m_in_frame;
+        uint32_t m_unknown_events;
+        uint32_t m_skipped_bytes;
+        uint32_t m_acknowledgements;
+        uint32_t m_restarts;
+        bool m_banner;
+
+        // after a checksum error, resumes from a start byte caught inside the frame
+        void restart();
+    };
+
+    // laid out to pack into 16 bytes for scanning arrays of them
+    struct Sample {
+        std::chrono::steady_clock::time_point timestamp;
+        Event event;
+        int8_t roll, pitch, yaw;
+    };
+
+    // Everything the console reports, kept up to date from the event stream
+    struct LiveState {
+        // stateful controls, as read by initialize() and then updated
+        ControlsState controls;
+        // knob positions and radio frequencies, starting from the state sent by initialize()
+        ConsoleState console;
+        uint16_t xpndr;
+        uint8_t cowl_flap, carb_heat;
+        int8_t roll, pitch, yaw;
+        // frames applied so far
+        uint64_t frames;
+        std::chrono::steady_clock::time_point timestamp;
+    };
+
+    struct Stats {
+        uint64_t frames;
+        uint64_t checksum_errors;
+        // frames that started but stopped arriving
+        uint64_t partial_frames;
+        // bytes outside frames skipped while looking for a start byte
+        uint64_t resync_bytes;
+        // bad frames that turned out to hold the start of the next one
+        uint64_t restarted_frames;
+        uint64_t unknown_events;
+        // reads that saw no frame at all, and waits that never saw their code
+        uint64_t frame_timeouts;
+        uint64_t code_timeouts;
+        uint64_t ack_failures;
+        // setup packets sent by update_console(), and ones never acknowledged
+        uint64_t console_updates;
+        uint64_t console_update_failures;
+        // commands sent by queue_command(), and ones never acknowledged
+        uint64_t commands;
+        uint64_t command_failures;
+        // between the start bytes of consecutive frames
+        Histogram::Snapshot frame_gap;
+        // what the timeouts are measured from: acknowledging a frame to the next
+        // one arriving, a command to its acknowledgement, a handshake step to the
+        // console's answer and the reset commands to the banner
+        Histogram::Snapshot turnaround;
+        Histogram::Snapshot command_ack;
+        Histogram::Snapshot response;
+        Histogram::Snapshot reset;
+        // from reading a frame's start byte to its Sample being produced
+        Histogram::Snapshot delivery;
+        Histogram::Snapshot ack_write;
+        // one record per successful initialize()
+        Histogram::Snapshot initialize_reset;
+        Histogram::Snapshot initialize_controls;
+        Histogram::Snapshot initialize_setup;
+        Histogram::Snapshot initialize_total;
+
+        double frame_rate() const { return frame_gap.count ? 1e6 / frame_gap.mean_us() : 0.0; }
+    };
+
     private:
+    static_assert(sizeof(Event) == 4);
+    static_assert(sizeof(Sample) == 16);
+
     static const ConsoleState DEFAULT_INITIAL_STATE;
     SerialProvider &m_serial;
+    TimeSource *m_time;
+    // the timeout set through set_read_timeout(), and the one the provider currently has
+    unsigned int m_read_multiplier;
     unsigned int m_read_timeout;
+    unsigned int m_port_multiplier;
+    unsigned int m_port_timeout;
     unsigned int m_write_timeout;
+    Pacing m_pacing;
+    unsigned int m_byte_gap;
+    InitializeTimings m_timings;
+    bool m_reset_on_destroy;
+    bool m_resilient;
+    // reattach() probing a console that may not answer, failures are not asserted on
+    bool m_probing;
+    std::atomic<Error> m_last_error;
+    uint8_t m_rx[256];
+    const uint8_t *m_rx_pos;
+    const uint8_t *m_rx_end;
+    FrameDecoder m_decoder;
+    std::thread m_acquisition;
+    std::atomic<bool> m_acquiring;
+    std::atomic<std::size_t> m_dropped;
+    std::unique_ptr<SPSCRing<Sample>> m_samples;
+    LiveState m_live;
+    Seqlock<LiveState> m_live_published;
+    SampleSink *m_sink;
+    FS200ACTrace *m_trace;
+    // written only by whichever thread is driving the port
+    struct Instruments {
+        std::atomic<uint64_t> frames;
+        std::atomic<uint64_t> checksum_errors;
+        std::atomic<uint64_t> partial_frames;
+        std::atomic<uint64_t> resync_bytes;
+        std::atomic<uint64_t> restarted_frames;
+        std::atomic<uint64_t> unknown_events;
+        std::atomic<uint64_t> frame_timeouts;
+        std::atomic<uint64_t> code_timeouts;
+        std::atomic<uint64_t> ack_failures;
+        std::atomic<uint64_t> console_updates;
+        std::atomic<uint64_t> console_update_failures;
+        std::atomic<uint64_t> commands;
+        std::atomic<uint64_t> command_failures;
+        Histogram frame_gap;
+        Histogram turnaround;
+        Histogram command_ack;
+        Histogram response;
+        Histogram reset;
+        Histogram delivery;
+        Histogram ack_write;
+        Histogram initialize_reset;
+        Histogram initialize_controls;
+        Histogram initialize_setup;
+        Histogram initialize_total;
+    } m_stats;
+    // when the current receive window was read, and the frame start bytes seen in one
+    std::chrono::steady_clock::time_point m_rx_time;
+    std::chrono::steady_clock::time_point m_frame_start;
+    std::chrono::steady_clock::time_point m_last_frame_start;
+    std::chrono::steady_clock::time_point m_last_ack;
+    Timeouts m_timeout_overrides;
+    Timeouts m_timeouts;
+    // update_console() and queue_command() hand their traffic to the polling
+    // thread through m_update_* and m_commands; m_outbound_pending is set while
+    // either holds something or a message is being sent
+    std::atomic<bool> m_console_valid;
+    std::mutex m_update_mutex;
+    ConsoleState m_update_state;
+    std::atomic<bool> m_update_requested;
+    std::deque<uint8_t> m_commands;
+    std::atomic<std::size_t> m_commands_pending;
+    std::atomic<bool> m_outbound_pending;
+    // owned by the polling thread: the packet the console last acknowledged
+    uint8_t m_console_packet[32];
+    // The message being written between frames, one at a time. Paced messages
+    // go out a byte per acknowledged frame, the rest in one write.
+    enum OutboundKind : uint8_t {
+        Outbound_None,
+        Outbound_Setup,
+        Outbound_Command,
+    };
+    struct Outbound {
+        uint8_t bytes[2 + 32];
+        uint8_t length;
+        uint8_t written;
+        bool paced;
+        int attempts;
+        // console acknowledgements counted before the last byte went out
+        uint32_t acks;
+        // when the next byte may go out, once all are written when the last one did
+        std::chrono::steady_clock::time_point due;
+    } m_outbound;
+    std::atomic<OutboundKind> m_outbound_kind;
+    ConsoleState m_update_sent_state;
 
-    bool wait_on_code(uint8_t code, int timeout);
+    // records error and returns false
+    bool report_error(Error error);
+    // as report_error(), but outside resilient mode the failure is also asserted on
+    bool fail(Error error);
+    bool wait_on_code(uint8_t code, std::chrono::milliseconds timeout);
+    // wait_on_code() for an answer to something just sent, measuring the turnaround
+    bool wait_on_response(uint8_t code);
+    // records the time from since to the receive window that held the answer
+    void record_turnaround(Histogram &histogram, std::chrono::steady_clock::time_point since);
+    void update_timeouts();
     bool send_command(uint8_t command, bool wait);
+    unsigned int command_gap(bool wait) const;
+    void command_acknowledged();
+    bool command_missed();
     // Note: also causes console to take state readings (returned by get_status())
-    bool reset_console(bool retry = true);
+    // streaming skips waiting for a boot banner, which frame data could fake
+    bool reset_console(bool retry = true, bool streaming = false);
     bool try_get_controls_state(ControlsState &controls);
     bool get_controls_state(ControlsState &controls);
     bool setup_console(const ConsoleState &state);
+    void console_setup_done(const uint8_t packet[32]);
+    // Drives the outbound message from the polling thread, right after a frame was
+    // acknowledged or given up on: writes what is due, checks for the console's
+    // acknowledgement and starts the next message once the current one is done.
+    void service_outbound(std::chrono::steady_clock::time_point now);
+    void write_outbound(std::chrono::steady_clock::time_point now);
+    void outbound_done(bool acknowledged);
+    // takes the next update or command off the queues, false when there is none
+    bool next_outbound();
+    // puts a message cut short by a reset or a lost link back at the head of its queue
+    void requeue_outbound();
     bool write_byte(uint8_t b);
-    void fill_event(Event &event, uint8_t b1, uint8_t b2, uint8_t b3);
+    // every write but frame ACKs goes through here to be traced
+    bool write_bytes(const uint8_t *bytes, std::size_t count);
+    void trace_write(const uint8_t *bytes, std::size_t count);
+    void set_read_timeout(unsigned int multiplier, unsigned int timeout_ms);
+    void apply_read_timeout(unsigned int multiplier, unsigned int timeout_ms);
+    bool fill_rx();
+    // Blocks in the provider for at most the time left until deadline. now is the
+    // caller's latest reading of the clock and is kept current, saving a clock read per call.
+    // A provider that lost its port ends the wait at once, as if the deadline had passed.
+    bool fill_rx_until(std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::time_point &now);
+    bool read_byte(uint8_t &b);
+    bool read_bytes(uint8_t *buffer, std::size_t count);
+    // runs the decoder over the receive window, keeping the frame statistics
+    FrameDecoder::Status decode_rx(FrameDecoder::Frame &frame);
+    // counts a read that gave up, as a partial frame or as no frame at all
+    void frame_timed_out();
+    void record_initialize_timings();
+    // acknowledges a decoded frame and turns it into a sample, every frame passes through here
+    bool acknowledge(const FrameDecoder::Frame &frame, Sample &sample);
+    bool read_frame(Sample &sample, std::chrono::milliseconds timeout);
+    void reset_live_state(const ControlsState &controls, const ConsoleState &console);
+    void update_live_state(const Sample &sample);
+    static void tune_radio(LiveState &live, uint16_t value);
+    void acquisition_loop();
+
+    Task<bool> fill_rx_async(Reactor &reactor, std::chrono::steady_clock::time_point deadline);
+    Task<bool> read_bytes_async(Reactor &reactor, uint8_t *buffer, std::size_t count, std::chrono::milliseconds timeout);
+    // write_bytes() without waiting in the provider, gives up after the write timeout send_command() sets
+    Task<bool> write_bytes_async(Reactor &reactor, const uint8_t *bytes, std::size_t count);
+    Task<bool> wait_on_code_async(Reactor &reactor, uint8_t code, std::chrono::milliseconds timeout);
+    Task<bool> wait_on_response_async(Reactor &reactor, uint8_t code);
+    Task<bool> send_command_async(Reactor &reactor, uint8_t command, bool wait);
+    Task<bool> reset_console_async(Reactor &reactor, bool retry = true, bool streaming = false);
+    Task<bool> try_get_controls_state_async(Reactor &reactor, ControlsState &controls);
+    Task<bool> get_controls_state_async(Reactor &reactor, ControlsState &controls);
+    Task<bool> setup_console_async(Reactor &reactor, const ConsoleState &state);
+    Task<bool> read_frame_async(Reactor &reactor, Sample &sample, std::chrono::milliseconds timeout);
+    // returns false for IDs the protocol table does not know
+    static bool fill_event(Event &event, uint8_t id, uint8_t b2, uint8_t b3);
 };
 
-#endif
+inline FS200AC::FrameDecoder::Status FS200AC::FrameDecoder::decode(const uint8_t *&pos, const uint8_t *end, Frame &frame) {
+    while (pos != end) {
+        uint8_t b = *pos++;
+        if (!m_in_frame) {
+            m_in_frame = (b == 0xa5);
+            if (!m_in_frame) {
+                // the console acknowledges setup packets between frames
+                if (b == CODE_ACKNOWLEDGE) {
+                    m_acknowledgements++;
+                } else {
+                    m_banner |= b == CODE_BANNER;
+                    m_skipped_bytes++;
+                }
+            }
+            continue;
+        }
+        m_buffer[m_count++] = b;
+        m_ck ^= b;
+        if (m_count < sizeof(m_buffer)) {
+            continue;
+        }
+        if (m_ck != 0x7f) {
+            restart();
+            return ChecksumError;
+        }
+        reset();
+        const uint8_t *buff = m_buffer;
+        frame.roll = (int8_t)((buff[0] & 2) ? -buff[2] : buff[2]);
+        frame.pitch = (int8_t)((buff[0] & 1) ? -buff[1] : buff[1]);
+        frame.yaw = (int8_t)((buff[0] & 4) ? -buff[3] : buff[3]);
+        if (!fill_event(frame.event, buff[4], buff[5], buff[6])) {
+            m_unknown_events++;
+        }
+        return FrameReady;
+    }
+    return NeedMore;
+}
 
+#endif
@@ -0,0 +1,153 @@
+#ifndef FS200AC_ASYNC_HPP
+#define FS200AC_ASYNC_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+// Lazily started coroutine returning a T. Awaiting it runs it to completion,
+// top-level tasks are kicked off with start() and polled with done().
+template<typename T>
+class Task {
+    public:
+    struct promise_type {
+        T value{};
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                auto continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_value(T v) { value = std::move(v); }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    Task(const Task&) = delete;
+    Task &operator=(const Task&) = delete;
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return m_handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+        m_handle.promise().continuation = caller;
+        return m_handle;
+    }
+    T await_resume() { return std::move(m_handle.promise().value); }
+
+    void start() { m_handle.resume(); }
+    bool done() const { return m_handle.done(); }
+    T &result() { return m_handle.promise().value; }
+
+    private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Coroutine producing a stream of values with co_yield. Consumers pull with
+// co_await next(), which returns nullptr once the stream has ended.
+template<typename T>
+class AsyncGenerator {
+    public:
+    struct promise_type {
+        const T *current = nullptr;
+        std::coroutine_handle<> consumer;
+
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        struct YieldAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().consumer;
+            }
+            void await_resume() noexcept {}
+        };
+        YieldAwaiter yield_value(const T &value) noexcept {
+            current = &value;
+            return {};
+        }
+        YieldAwaiter final_suspend() noexcept { return {}; }
+        void return_void() { current = nullptr; }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    struct NextAwaiter {
+        std::coroutine_handle<promise_type> handle;
+        bool await_ready() noexcept { return handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+            handle.promise().consumer = consumer;
+            return handle;
+        }
+        const T *await_resume() noexcept { return handle.done() ? nullptr : handle.promise().current; }
+    };
+
+    AsyncGenerator(AsyncGenerator &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator &operator=(const AsyncGenerator&) = delete;
+    ~AsyncGenerator() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    NextAwaiter next() { return NextAwaiter{m_handle}; }
+
+    private:
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Readiness source the async protocol code suspends on. Implementations resume
+// the handle once the fd is readable or the deadline passes, whichever is first,
+// setting *readable beforehand in the first case.
+class Reactor {
+    public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    virtual ~Reactor() {}
+    virtual void wait_readable(int fd, TimePoint deadline, std::coroutine_handle<> handle, bool *readable) = 0;
+    virtual void wait_until(TimePoint deadline, std::coroutine_handle<> handle) = 0;
+
+    // resumes with true if fd became readable, false if the deadline passed first
+    struct ReadableAwaiter {
+        Reactor &reactor;
+        int fd;
+        TimePoint deadline;
+        bool readable;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { reactor.wait_readable(fd, deadline, handle, &readable); }
+        bool await_resume() noexcept { return readable; }
+    };
+    struct TimerAwaiter {
+        Reactor &reactor;
+        TimePoint deadline;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { reactor.wait_until(deadline, handle); }
+        void await_resume() noexcept {}
+    };
+
+    ReadableAwaiter readable(int fd, TimePoint deadline) { return ReadableAwaiter{*this, fd, deadline, false}; }
+    TimerAwaiter sleep_until(TimePoint deadline) { return TimerAwaiter{*this, deadline}; }
+    template<typename Rep, typename Period>
+    TimerAwaiter sleep_for(std::chrono::duration<Rep, Period> duration) {
+        return sleep_until(std::chrono::steady_clock::now() +
+                           std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration));
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef FS200AC_CAPTURE_HPP
+#define FS200AC_CAPTURE_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "FS200AC.hpp"
+
+// Passes everything through to another provider and appends every byte read
+// or written to a capture file. Files start with MAGIC and a Header followed by
+// records, each a Record header and then length bytes exactly as they crossed
+// the port. Appending is only done to files in the current format.
+class CaptureProvider : public FS200AC::SerialProvider {
+    public:
+    static constexpr char MAGIC[8] = {'F', 'S', '2', '0', '0', 'C', 'P', '2'};
+    // earlier files: no Header, records stamped with system_clock
+    static constexpr char MAGIC_V1[8] = {'F', 'S', '2', '0', '0', 'C', 'A', 'P'};
+
+    // the moment the file was created on both clocks, for turning record
+    // timestamps into wall-clock time
+    struct Header {
+        int64_t steady_ns;
+        int64_t system_ns;
+    };
+    static_assert(sizeof(Header) == 16, "capture headers have a fixed layout");
+
+    enum Direction : uint8_t {
+        Direction_Read,
+        Direction_Write,
+    };
+
+    struct Record {
+        uint32_t length;
+        uint8_t direction;
+        uint8_t reserved[3];
+        // steady_clock time, only meaningful relative to other records and the Header
+        int64_t timestamp_ns;
+    };
+    static_assert(sizeof(Record) == 16, "capture records have a fixed layout");
+
+    CaptureProvider(FS200AC::SerialProvider &serial, const char *path);
+    ~CaptureProvider();
+    CaptureProvider(const CaptureProvider&) = delete;
+    CaptureProvider &operator=(const CaptureProvider&) = delete;
+
+    bool is_open() const { return m_file != nullptr; }
+    void flush();
+
+    virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms);
+    virtual void setWriteTimeout(unsigned int multiplier);
+    virtual bool read(uint8_t *buffer, std::size_t count);
+    virtual bool write(const uint8_t *buffer, std::size_t count);
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count);
+    virtual std::size_t write_some(const uint8_t *buffer, std::size_t count);
+    virtual int native_handle() { return m_serial.native_handle(); }
+    virtual const char *port_name() { return m_serial.port_name(); }
+    virtual bool connected() { return m_serial.connected(); }
+
+    private:
+    FS200AC::SerialProvider &m_serial;
+    FILE *m_file;
+    unsigned int m_read_multiplier;
+    unsigned int m_read_timeout;
+
+    void record(Direction direction, const uint8_t *data, std::size_t count);
+};
+
+// Feeds the reads of a capture file back, either paced by the recorded
+// timestamps or as fast as they are consumed (POSIX only). The file is mapped
+// and handed out through read_view() without copying; writes are discarded.
+class ReplayProvider : public FS200AC::SerialProvider {
+    public:
+    enum Mode {
+        Mode_Realtime,
+        Mode_Fast,
+    };
+
+    explicit ReplayProvider(const char *path, Mode mode = Mode_Fast);
+    ~ReplayProvider();
+    ReplayProvider(const ReplayProvider&) = delete;
+    ReplayProvider &operator=(const ReplayProvider&) = delete;
+
+    bool is_open() const { return m_begin != nullptr; }
+    // when the capture was started, the epoch for files without a Header
+    std::chrono::system_clock::time_point captured_at() const { return m_captured_at; }
+    // all recorded reads have been handed out
+    bool finished() const { return m_pos == m_end && m_record_pos == m_record_end; }
+    // starts over from the first record
+    void rewind();
+
+    virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms);
+    virtual void setWriteTimeout(unsigned int multiplier);
+    virtual bool read(uint8_t *buffer, std::size_t count);
+    virtual bool write(const uint8_t *buffer, std::size_t count);
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count);
+    virtual const uint8_t *read_view(std::size_t &count);
+
+    private:
+    Mode m_mode;
+    const uint8_t *m_begin;
+    const uint8_t *m_end;
+    // first record header
+    const uint8_t *m_records;
+    // next record header
+    const uint8_t *m_pos;
+    // unread part of the current read record
+    const uint8_t *m_record_pos;
+    const uint8_t *m_record_end;
+    std::size_t m_size;
+    unsigned int m_read_multiplier;
+    unsigned int m_read_timeout;
+    bool m_started;
+    int64_t m_first_timestamp;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::system_clock::time_point m_captured_at;
+
+    std::chrono::steady_clock::time_point read_deadline(std::size_t count) const;
+    void skip_writes();
+    bool next_record(std::chrono::steady_clock::time_point deadline);
+    std::size_t take(uint8_t *buffer, std::size_t count, std::chrono::steady_clock::time_point deadline);
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef FS200AC_EMULATOR_HPP
+#define FS200AC_EMULATOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FS200AC.hpp"
+
+// Software model of the console side of the protocol: the reset/'X' handshake,
+// the controls state block sent for commands 0x36/0x23, the 0xa5 0x19 setup
+// packet and the acknowledged 0xa5 input frames. It is transport agnostic; use
+// Provider to drive it in-process or PtyServer to expose it as a tty.
+class FS200ACEmulator {
+    public:
+    typedef std::chrono::steady_clock Clock;
+
+    // undecoded frame contents, as the console puts them on the wire
+    struct Frame {
+        int8_t roll, pitch, yaw;
+        uint8_t id;
+        uint8_t data[2];
+    };
+
+    struct Options {
+        FS200AC::ControlsState controls;
+        // frames per second while streaming, 0 streams as fast as frames are acknowledged
+        double frame_rate;
+        // line speed used to pace output bytes, 0 delivers them instantly
+        unsigned int baud;
+        // the console sends 'X' on power up
+        bool boot_banner;
+        // frames nobody supplied cycle through every control instead of idling
+        bool synthetic;
+        // an unacknowledged frame is sent again after this long
+        std::chrono::milliseconds ack_timeout;
+        // command bytes arriving closer together than this are lost, as they
+        // would be by slow console firmware
+        std::chrono::milliseconds min_byte_gap;
+        Options();
+    };
+
+    enum State {
+        Idle,
+        SendingControls,
+        RequestingSetup,
+        AwaitingSetup,
+        Streaming,
+    };
+
+    explicit FS200ACEmulator(const Options &options = Options());
+
+    // bytes written by the host
+    void receive(const uint8_t *data, std::size_t count);
+    // copies out bytes the console has put on the line by now
+    std::size_t transmit(uint8_t *buffer, std::size_t count, Clock::time_point now);
+    // when the next byte will be available, Clock::time_point::max() if the console is waiting on the host
+    Clock::time_point next_output(Clock::time_point now);
+
+    // queues a frame to be streamed ahead of idle/synthetic frames
+    void push_frame(const Frame &frame);
+    // power cycles the console
+    void power_cycle();
+
+    State state() const;
+    // contents of the last valid setup packet
+    FS200AC::ConsoleState console_state() const;
+    // distinct frames, a frame sent again after ack_timeout counts once
+    uint64_t frames_sent() const { return m_frames_sent.load(std::memory_order_relaxed); }
+    uint64_t frames_acknowledged() const { return m_frames_acked.load(std::memory_order_relaxed); }
+
+    // SerialProvider talking to the emulator in the calling thread. Reads that
+    // could only be satisfied by the host writing something fail immediately.
+    class Provider : public FS200AC::SerialProvider {
+        public:
+        explicit Provider(FS200ACEmulator &emulator);
+        virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms);
+        virtual void setWriteTimeout(unsigned int multiplier);
+        virtual bool read(uint8_t *buffer, std::size_t count);
+        virtual bool write(const uint8_t *buffer, std::size_t count);
+        virtual std::size_t read_some(uint8_t *buffer, std::size_t count);
+
+        private:
+        FS200ACEmulator &m_emulator;
+        unsigned int m_read_multiplier;
+        unsigned int m_read_constant;
+    };
+
+    // Serves the emulator on the master side of a pseudo-terminal from a
+    // background thread (Linux only). The host opens slave_name().
+    class PtyServer {
+        public:
+        explicit PtyServer(FS200ACEmulator &emulator);
+        ~PtyServer();
+        bool start();
+        void stop();
+        const std::string &slave_name() const { return m_slave_name; }
+
+        private:
+        FS200ACEmulator &m_emulator;
+        int m_master;
+        int m_slave;
+        std::string m_slave_name;
+        std::atomic<bool> m_running;
+        std::thread m_thread;
+        void run();
+    };
+
+    private:
+    struct Output {
+        uint8_t byte;
+        Clock::time_point ready;
+    };
+
+    Options m_options;
+    mutable std::mutex m_mutex;
+    State m_state;
+    FS200AC::ConsoleState m_console;
+    std::deque<Output> m_output;
+    std::deque<Frame> m_frames;
+    Clock::time_point m_line_free;
+    Clock::time_point m_frame_sent;
+    Clock::time_point m_next_frame;
+    bool m_awaiting_ack;
+    // the frame last put on the line, sent again until it is acknowledged
+    uint8_t m_pending_frame[9];
+    uint64_t m_synthetic_index;
+    std::atomic<uint64_t> m_frames_sent;
+    std::atomic<uint64_t> m_frames_acked;
+
+    // host byte parser
+    uint8_t m_packet[34];
+    std::size_t m_packet_length;
+    Clock::time_point m_last_byte;
+
+    void queue(const uint8_t *data, std::size_t count, Clock::time_point now);
+    void handle_byte(uint8_t b, Clock::time_point now);
+    void handle_command(uint8_t command, Clock::time_point now);
+    void handle_ack(Clock::time_point now);
+    void stream(Clock::time_point now);
+    Frame next_frame();
+};
+
+#endif
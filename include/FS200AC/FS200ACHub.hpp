@@ -0,0 +1,77 @@
+#ifndef FS200AC_HUB_HPP
+#define FS200AC_HUB_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "FS200AC.hpp"
+#include "EpollReactor.hpp"
+#include "SPSCRing.hpp"
+
+// Drives any number of consoles from a single epoll thread (Linux only). All
+// handshakes run concurrently and every sample is delivered through one queue,
+// tagged with the index add_console() returned.
+class FS200ACHub {
+    public:
+    struct TaggedSample {
+        std::size_t console;
+        FS200AC::Sample sample;
+    };
+
+    enum Status {
+        Stopped,
+        Initializing,
+        Streaming,
+        Failed,
+    };
+
+    explicit FS200ACHub(std::size_t queue_capacity = 4096);
+    ~FS200ACHub();
+    FS200ACHub(const FS200ACHub&) = delete;
+    FS200ACHub &operator=(const FS200ACHub&) = delete;
+
+    // Consoles are added before start(). The provider must outlive the hub and
+    // should expose native_handle(), providers without one are polled.
+    // A null initial_state selects the library default.
+    std::size_t add_console(FS200AC::SerialProvider &provider,
+                            const FS200AC::ConsoleState *initial_state = nullptr);
+    std::size_t size() const { return m_consoles.size(); }
+
+    bool start();
+    // lets every console finish its current step, resets them all concurrently and joins the thread
+    void stop();
+
+    // single consumer
+    bool pop(TaggedSample &sample);
+    std::size_t pop(TaggedSample *samples, std::size_t count);
+    std::size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    Status status(std::size_t console) const;
+    // valid once the console is Streaming
+    const FS200AC::ControlsState &controls(std::size_t console) const;
+    FS200AC &console(std::size_t console);
+
+    private:
+    struct Console {
+        FS200AC fs;
+        bool use_default_state;
+        FS200AC::ConsoleState initial_state;
+        FS200AC::ControlsState controls;
+        std::atomic<Status> status;
+        Console(FS200AC::SerialProvider &provider) : fs(provider), status(Stopped) {}
+    };
+
+    EpollReactor m_reactor;
+    std::vector<std::unique_ptr<Console>> m_consoles;
+    SPSCRing<TaggedSample> m_samples;
+    std::atomic<std::size_t> m_dropped;
+    std::atomic<bool> m_stopping;
+    std::thread m_thread;
+
+    void run();
+    Task<bool> run_console(std::size_t index);
+};
+
+#endif
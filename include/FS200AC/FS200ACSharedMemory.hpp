@@ -0,0 +1,100 @@
+#ifndef FS200AC_SHAREDMEMORY_HPP
+#define FS200AC_SHAREDMEMORY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "FS200AC.hpp"
+
+// Publishes one console's samples and live state to any number of local
+// processes through a POSIX shared memory object (Linux only). Samples go into
+// a ring of versioned slots and the live state behind a seqlock, so readers
+// never block the publisher and the publisher never waits for readers.
+class SharedMemoryPublisher : public FS200AC::SampleSink {
+    public:
+    static constexpr uint64_t MAGIC = 0x4653323030414331ull;
+    static constexpr uint32_t VERSION = 2;
+
+    struct Slot {
+        // 2n + 2 once sample n is complete, odd while it is being written
+        std::atomic<uint64_t> seq;
+        std::atomic<uint64_t> words[sizeof(FS200AC::Sample) / sizeof(uint64_t)];
+    };
+
+    // what the shared memory object holds, followed by the slots
+    struct Region {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t capacity;
+        uint32_t sample_size;
+        uint32_t live_size;
+        // pid of the publisher, so the next one can tell a name left behind by a crash
+        int32_t owner;
+        // samples published so far
+        alignas(64) std::atomic<uint64_t> head;
+        Seqlock<FS200AC::LiveState> live;
+    };
+
+    // Creates /name; capacity is rounded up to a power of two. An object whose
+    // publisher has exited without removing it is replaced, one that is still
+    // owned by a running publisher is left alone and error() is EEXIST.
+    explicit SharedMemoryPublisher(const char *name, std::size_t capacity = 4096);
+    // unmaps and removes the name, attached readers keep their mapping
+    ~SharedMemoryPublisher();
+    SharedMemoryPublisher(const SharedMemoryPublisher&) = delete;
+    SharedMemoryPublisher &operator=(const SharedMemoryPublisher&) = delete;
+
+    bool is_open() const { return m_region != nullptr; }
+    // errno of what kept the publisher from opening, 0 once it is open
+    int error() const { return m_error; }
+
+    // single writer, normally called through FS200AC::set_sample_sink()
+    void publish(const FS200AC::Sample &sample);
+    void publish_live(const FS200AC::LiveState &live) { m_region->live.store(live); }
+    virtual void on_sample(const FS200AC::Sample &sample, const FS200AC::LiveState &live);
+
+    static std::size_t region_size(std::size_t capacity);
+
+    private:
+    std::string m_name;
+    Region *m_region;
+    Slot *m_slots;
+    std::size_t m_size;
+    uint64_t m_mask;
+    uint64_t m_head;
+    int m_error;
+};
+
+// Attaches to a SharedMemoryPublisher by name, read only.
+class SharedMemorySubscriber {
+    public:
+    explicit SharedMemorySubscriber(const char *name);
+    ~SharedMemorySubscriber();
+    SharedMemorySubscriber(const SharedMemorySubscriber&) = delete;
+    SharedMemorySubscriber &operator=(const SharedMemorySubscriber&) = delete;
+
+    bool is_open() const { return m_region != nullptr; }
+
+    // next unread sample, starting with the first one published after attaching
+    bool pop(FS200AC::Sample &sample);
+    std::size_t pop(FS200AC::Sample *samples, std::size_t count);
+    // samples the publisher overwrote before they were read
+    uint64_t lost() const { return m_lost; }
+    // skips whatever has not been read yet
+    void seek_latest();
+
+    // false if no consistent copy could be taken, e.g. the publisher died mid-store
+    bool live_state(FS200AC::LiveState &live) const;
+    uint64_t live_version() const { return m_region->live.version(); }
+
+    private:
+    const SharedMemoryPublisher::Region *m_region;
+    const SharedMemoryPublisher::Slot *m_slots;
+    std::size_t m_size;
+    uint64_t m_mask;
+    uint64_t m_tail;
+    uint64_t m_lost;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef FS200AC_SUPERVISOR_HPP
+#define FS200AC_SUPERVISOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "FS200AC.hpp"
+#include "Histogram.hpp"
+#include "SPSCRing.hpp"
+
+// Keeps one console streaming through power cycles, stalls and ports that
+// disappear and come back, e.g. a USB adapter re-enumerating. A background
+// thread owns the port: it opens it through the factory, initializes the console
+// once and from then on only reattaches, which costs a frame or two when the
+// console kept its setup and restores the last known ConsoleState when it did not.
+class FS200ACSupervisor {
+    public:
+    // opens the port, nullptr while it is not there
+    typedef std::function<std::unique_ptr<FS200AC::SerialProvider>()> ProviderFactory;
+
+    enum Status {
+        Stopped,
+        // waiting for the port to appear
+        Connecting,
+        // initializing or reattaching the console
+        Attaching,
+        Streaming,
+    };
+
+    struct Options {
+        // no frame for this long and the console is reattached
+        std::chrono::milliseconds stall_timeout;
+        // between attempts to open a missing port or reach a silent console
+        std::chrono::milliseconds retry_interval;
+        std::size_t queue_capacity;
+        Options();
+    };
+
+    // A null initial_state selects the library default.
+    explicit FS200ACSupervisor(ProviderFactory factory, const FS200AC::ConsoleState *initial_state = nullptr,
+                               const Options &options = Options());
+    // resets the console if it is still attached
+    ~FS200ACSupervisor();
+    FS200ACSupervisor(const FS200ACSupervisor&) = delete;
+    FS200ACSupervisor &operator=(const FS200ACSupervisor&) = delete;
+
+    bool start();
+    // joins the thread, which finishes an initialize() in progress first
+    void stop();
+
+    Status status() const { return m_status.load(std::memory_order_relaxed); }
+    // single consumer
+    bool pop(FS200AC::Sample &sample);
+    std::size_t pop(FS200AC::Sample *samples, std::size_t count);
+    std::size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Safe from any thread. Reaches the console as soon as it is attached and
+    // is restored by every reattach that has to set the console up again.
+    void update_console(const FS200AC::ConsoleState &state);
+    // FS200AC::queue_command(), refused until the console is first attached;
+    // a command cut short by an outage is sent again after the reattach
+    bool queue_command(uint8_t command) { return m_fs.queue_command(command); }
+    FS200AC::LiveState live_state() const { return m_fs.live_state(); }
+    FS200AC::Stats stats() const { return m_fs.stats(); }
+    // for settings such as set_pacing(), before start()
+    FS200AC &console() { return m_fs; }
+
+    // ports opened after the first one, and reattaches that got the console back
+    uint64_t reopens() const { return m_reopens.load(std::memory_order_relaxed); }
+    uint64_t reattaches() const { return m_reattaches.load(std::memory_order_relaxed); }
+    // from the last frame before an outage to the first one after it
+    Histogram::Snapshot outages() const { return m_outages.snapshot(); }
+
+    private:
+    // the provider the console sees, forwarding to whichever port is open
+    class Link : public FS200AC::SerialProvider {
+        public:
+        bool open(const ProviderFactory &factory);
+        void close() { m_port.reset(); }
+
+        virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms);
+        virtual void setWriteTimeout(unsigned int multiplier);
+        virtual bool read(uint8_t *buffer, std::size_t count);
+        virtual bool write(const uint8_t *buffer, std::size_t count);
+        virtual std::size_t read_some(uint8_t *buffer, std::size_t count);
+        virtual std::size_t write_some(const uint8_t *buffer, std::size_t count);
+        virtual const uint8_t *read_view(std::size_t &count);
+        virtual int native_handle() { return m_port ? m_port->native_handle() : -1; }
+        virtual const char *port_name() { return m_port ? m_port->port_name() : nullptr; }
+        virtual bool connected() { return m_port && m_port->connected(); }
+
+        private:
+        std::unique_ptr<FS200AC::SerialProvider> m_port;
+    };
+
+    ProviderFactory m_factory;
+    Options m_options;
+    // declared before m_fs, which resets the console through it on destruction
+    Link m_link;
+    FS200AC m_fs;
+    SPSCRing<FS200AC::Sample> m_samples;
+    std::atomic<std::size_t> m_dropped;
+    std::atomic<Status> m_status;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_reopens;
+    std::atomic<uint64_t> m_reattaches;
+    Histogram m_outages;
+    // update_console() before the first initialize() lands here
+    std::mutex m_state_mutex;
+    bool m_use_default_state;
+    FS200AC::ConsoleState m_initial_state;
+    uint64_t m_state_version;
+    std::thread m_thread;
+
+    void run();
+    bool initialize();
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef FS200AC_TRACE_HPP
+#define FS200AC_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FS200AC.hpp"
+#include "SPSCRing.hpp"
+
+// Protocol trace that stays off the I/O path of the threads it traces. Each
+// recording thread gets a lock-free ring of its own on its first entry and only
+// copies fixed-size binary entries into it; a background thread collects them
+// from every ring, orders them by timestamp and formats them, naming controls
+// through FS200AC::control_name(). Entries are written once every ring has
+// moved past them, or after a short hold-back when a thread is quiet, so an
+// entry stamped that long before it was recorded can still come out of order.
+// A full ring drops the entry and counts it rather than making the recording
+// thread wait.
+class FS200ACTrace {
+    public:
+    enum Kind : uint8_t {
+        // a frame decoded and acknowledged
+        Kind_Frame,
+        // bytes as they came off the port
+        Kind_Read,
+        // bytes written other than frame ACKs: commands, setup packets and handshake replies
+        Kind_Write,
+        Kind_Error,
+    };
+
+    struct Entry {
+        std::chrono::steady_clock::time_point timestamp;
+        Kind kind;
+        // of bytes
+        uint8_t length;
+        // Kind_Error
+        uint8_t error;
+        // Kind_Frame
+        int8_t roll, pitch, yaw;
+        FS200AC::Event event;
+        // raw bytes, a longer read or write takes several entries
+        uint8_t bytes[44];
+    };
+    static_assert(sizeof(Entry) == 64, "entries fill one cache line");
+
+    // Formats to out, which is not closed. capacity is in entries per recording thread.
+    explicit FS200ACTrace(FILE *out, std::size_t capacity = 1024);
+    // stops the formatter after it has written everything recorded so far
+    ~FS200ACTrace();
+    FS200ACTrace(const FS200ACTrace&) = delete;
+    FS200ACTrace &operator=(const FS200ACTrace&) = delete;
+
+    bool start();
+    void stop();
+
+    // kinds recorded, as a mask of 1 << Kind; reads are left out unless asked for
+    void set_kinds(unsigned int kinds) { m_kinds.store(kinds, std::memory_order_relaxed); }
+    bool wants(Kind kind) const { return m_kinds.load(std::memory_order_relaxed) & (1u << kind); }
+
+    // any thread
+    void record(const Entry &entry);
+    // data is the 8 bytes that followed the start byte
+    void record_frame(const FS200AC::Sample &sample, const uint8_t data[8]);
+    void record_bytes(Kind kind, std::chrono::steady_clock::time_point timestamp, const uint8_t *bytes, std::size_t count);
+    void record_error(std::chrono::steady_clock::time_point timestamp, FS200AC::Error error);
+
+    // entries lost to full rings, and entries formatted
+    uint64_t dropped() const;
+    uint64_t written() const { return m_written.load(std::memory_order_relaxed); }
+
+    private:
+    struct Buffer {
+        Buffer(std::size_t capacity, std::thread::id owner) : ring(capacity), dropped(0), owner(owner), latest() {}
+        SPSCRing<Entry> ring;
+        std::atomic<uint64_t> dropped;
+        std::thread::id owner;
+        // timestamp of the newest entry drained, formatter thread only
+        std::chrono::steady_clock::time_point latest;
+    };
+
+    FILE *m_out;
+    std::size_t m_capacity;
+    // tells this trace apart in the per-thread cache, even at a reused address
+    uint64_t m_id;
+    std::atomic<unsigned int> m_kinds;
+    std::chrono::steady_clock::time_point m_start;
+    mutable std::mutex m_buffers_mutex;
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_written;
+    std::thread m_thread;
+
+    Buffer *local_buffer();
+    void run();
+    // Drains every ring once into entries and writes those every ring has moved
+    // past, all of them on the final pass; returns the number of entries written.
+    std::size_t drain(std::vector<Entry> &entries, bool final);
+    void format(const Entry &entry);
+};
+
+#endif
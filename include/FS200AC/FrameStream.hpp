@@ -0,0 +1,72 @@
+#ifndef FS200AC_FRAMESTREAM_HPP
+#define FS200AC_FRAMESTREAM_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+#include "FS200AC.hpp"
+
+// What basic_FrameStream needs from a transport. FS200AC::SerialProvider
+// qualifies, but a concrete class lets every call be inlined. read_view() is
+// optional, as on SerialProvider.
+template<typename T>
+concept FrameTransport = requires(T &transport, uint8_t *buffer, const uint8_t *data, std::size_t count) {
+    { transport.read_some(buffer, count) } -> std::convertible_to<std::size_t>;
+    { transport.write(data, count) } -> std::convertible_to<bool>;
+};
+
+// Decodes and acknowledges the frames of an already initialized console
+// without going through virtual calls, for in-process transports such as
+// emulators and replays where those calls dominate. It keeps none of
+// FS200AC's statistics, live state or timeouts: the transport's read_some()
+// decides how long to wait.
+template<FrameTransport Transport>
+class basic_FrameStream {
+    public:
+    typedef FS200AC::FrameDecoder::Frame Frame;
+
+    explicit basic_FrameStream(Transport &transport) : m_transport(transport), m_pos(m_rx), m_end(m_rx) {}
+
+    // false once the transport has nothing more to read or the ACK cannot be written
+    bool next(Frame &frame) {
+        for (;;) {
+            if (m_pos == m_end && !fill()) {
+                return false;
+            }
+            // checksum errors resynchronize inside the decoder
+            if (m_decoder.decode(m_pos, m_end, frame) == FS200AC::FrameDecoder::FrameReady) {
+                return m_transport.write(&FS200AC::CODE_ACKNOWLEDGE, 1);
+            }
+        }
+    }
+
+    const FS200AC::FrameDecoder &decoder() const { return m_decoder; }
+
+    private:
+    Transport &m_transport;
+    FS200AC::FrameDecoder m_decoder;
+    uint8_t m_rx[256];
+    const uint8_t *m_pos;
+    const uint8_t *m_end;
+
+    bool fill() {
+        std::size_t count = 0;
+        if constexpr (requires { { m_transport.read_view(count) } -> std::convertible_to<const uint8_t*>; }) {
+            if (const uint8_t *view = m_transport.read_view(count)) {
+                m_pos = view;
+                m_end = view + count;
+                return count != 0;
+            }
+        }
+        count = m_transport.read_some(m_rx, sizeof(m_rx));
+        m_pos = m_rx;
+        m_end = m_rx + count;
+        return count != 0;
+    }
+};
+
+// the same code driving any SerialProvider through its vtable
+typedef basic_FrameStream<FS200AC::SerialProvider> FrameStream;
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef FS200AC_HISTOGRAM_HPP
+#define FS200AC_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+// Fixed-bucket histogram of durations for one writer thread and any number of
+// readers. Bucket 0 counts 0 us, bucket i counts [2^(i-1), 2^i) us and the last
+// bucket everything longer, about 8 s and up.
+class Histogram {
+    public:
+    static constexpr std::size_t BUCKETS = 24;
+
+    struct Snapshot {
+        uint64_t buckets[BUCKETS];
+        uint64_t count;
+        uint64_t sum_us;
+        uint64_t max_us;
+
+        double mean_us() const { return count ? (double)sum_us / count : 0.0; }
+        // upper bound of the bucket holding the given fraction of samples, 0 < p <= 1,
+        // never more than the largest value recorded
+        uint64_t percentile_us(double p) const {
+            uint64_t rank = (uint64_t)(p * count + 0.5);
+            uint64_t seen = 0;
+            for (std::size_t i = 0; i < BUCKETS; i++) {
+                seen += buckets[i];
+                if (seen >= rank && seen) {
+                    return i + 1 < BUCKETS ? std::min(bucket_limit_us(i), max_us) : max_us;
+                }
+            }
+            return 0;
+        }
+        static uint64_t bucket_limit_us(std::size_t bucket) { return bucket ? (1ull << bucket) - 1 : 0; }
+    };
+
+    Histogram() {
+        for (auto &bucket : m_buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    // single writer only, which is what lets it skip read-modify-write instructions
+    void record(std::chrono::microseconds duration) {
+        uint64_t us = duration.count() > 0 ? (uint64_t)duration.count() : 0;
+        std::size_t bucket = std::bit_width(us);
+        if (bucket >= BUCKETS) {
+            bucket = BUCKETS - 1;
+        }
+        bump(m_buckets[bucket], 1);
+        bump(m_count, 1);
+        bump(m_sum, us);
+        if (us > m_max.load(std::memory_order_relaxed)) {
+            m_max.store(us, std::memory_order_relaxed);
+        }
+    }
+
+    // counts can be a few records apart from each other if taken while recording
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        for (std::size_t i = 0; i < BUCKETS; i++) {
+            snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.count = m_count.load(std::memory_order_relaxed);
+        snapshot.sum_us = m_sum.load(std::memory_order_relaxed);
+        snapshot.max_us = m_max.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    static void bump(std::atomic<uint64_t> &counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef FS200AC_LINUXSERIALPROVIDER_HPP
+#define FS200AC_LINUXSERIALPROVIDER_HPP
+
+#include <string>
+
+#include "FS200AC.hpp"
+
+// SerialProvider over a termios tty (Linux only). The fd is non-blocking and
+// timeouts are implemented with epoll, following the serial library convention
+// of constant + multiplier * bytes milliseconds.
+class LinuxSerialProvider : public FS200AC::SerialProvider {
+    public:
+    // opens path and configures it as raw 9600 8N1
+    explicit LinuxSerialProvider(const char *path, bool low_latency = true);
+    // takes ownership of an open tty fd, e.g. one side of a pty pair
+    explicit LinuxSerialProvider(int fd, bool low_latency = true);
+    ~LinuxSerialProvider();
+    LinuxSerialProvider(const LinuxSerialProvider&) = delete;
+    LinuxSerialProvider &operator=(const LinuxSerialProvider&) = delete;
+
+    bool is_open() const { return m_fd >= 0; }
+    // whether the driver accepted ASYNC_LOW_LATENCY
+    bool low_latency() const { return m_low_latency; }
+
+    virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms);
+    virtual void setWriteTimeout(unsigned int multiplier);
+    virtual bool read(uint8_t *buffer, std::size_t count);
+    virtual bool write(const uint8_t *buffer, std::size_t count);
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count);
+    virtual std::size_t write_some(const uint8_t *buffer, std::size_t count);
+    virtual int native_handle() { return m_fd; }
+    virtual const char *port_name() { return m_path.empty() ? nullptr : m_path.c_str(); }
+    // false after the device reported an error, e.g. it was unplugged
+    virtual bool connected() { return m_fd >= 0 && !m_lost; }
+
+    // opens a pseudo-terminal pair, the slave end can be handed to the constructor
+    static bool open_pty_pair(int &master, int &slave);
+
+    private:
+    int m_fd;
+    int m_epoll;
+    std::string m_path;
+    uint32_t m_events;
+    bool m_low_latency;
+    bool m_lost;
+    unsigned int m_read_multiplier;
+    unsigned int m_read_constant;
+    unsigned int m_write_multiplier;
+
+    void configure(bool low_latency);
+    bool wait(uint32_t events, int timeout_ms);
+    // whether an errno from read() or write() is transient, otherwise the port is lost
+    bool transient(int error);
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef FS200AC_SPSCRING_HPP
+#define FS200AC_SPSCRING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// bounded lock-free ring for exactly one producer thread and one consumer thread
+template<typename T>
+class SPSCRing {
+    public:
+    explicit SPSCRing(std::size_t capacity) {
+        m_capacity = 1;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_mask = m_capacity - 1;
+        m_items.reset(new T[m_capacity]);
+    }
+
+    std::size_t capacity() const { return m_capacity; }
+
+    std::size_t size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    // producer side, returns false if the ring is full
+    bool push(const T &item) {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == m_capacity) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == m_capacity) {
+                return false;
+            }
+        }
+        m_items[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T &item) {
+        return pop(&item, 1) == 1;
+    }
+
+    std::size_t pop(T *items, std::size_t count) {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_cached_tail - head < count) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+        }
+        std::size_t available = m_cached_tail - head;
+        if (count > available) {
+            count = available;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            items[i] = m_items[(head + i) & m_mask];
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    private:
+    std::unique_ptr<T[]> m_items;
+    std::size_t m_capacity;
+    std::size_t m_mask;
+    // producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_cached_head = 0;
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    std::size_t m_cached_tail = 0;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef FS200AC_SEQLOCK_HPP
+#define FS200AC_SEQLOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Publishes a plain struct from one writer thread to any number of readers.
+// Readers never block the writer; they retry if a store overlapped their copy.
+// The value is held as atomic words so a torn read is never a data race.
+template<typename T>
+class Seqlock {
+    static_assert(std::is_trivially_destructible_v<T>);
+    static constexpr std::size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    public:
+    Seqlock() {
+        for (auto &word : m_words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // single writer only
+    void store(const T &value) {
+        uint64_t words[WORDS] = {};
+        std::memcpy(words, &value, sizeof(T));
+        uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < WORDS; i++) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        T value;
+        while (!try_load(value)) {
+        }
+        return value;
+    }
+
+    // one attempt, fails if a store overlapped it; for writers that may die mid-store
+    bool try_load(T &value) const {
+        uint64_t words[WORDS];
+        uint64_t before = m_seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+        for (std::size_t i = 0; i < WORDS; i++) {
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        std::memcpy((void*)&value, words, sizeof(T));
+        return true;
+    }
+
+    // number of stores so far, lets readers skip unchanged values cheaply
+    uint64_t version() const { return m_seq.load(std::memory_order_acquire) / 2; }
+
+    private:
+    alignas(64) std::atomic<uint64_t> m_seq{0};
+    std::atomic<uint64_t> m_words[WORDS];
+};
+
+#endif
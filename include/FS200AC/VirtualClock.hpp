@@ -0,0 +1,50 @@
+#ifndef FS200AC_VIRTUALCLOCK_HPP
+#define FS200AC_VIRTUALCLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "FS200AC.hpp"
+
+// A time source that only moves when told to. sleep_until() jumps straight to
+// its target, so a timeout that runs out completes at once with now() exactly at
+// the deadline, and sleeps() shows how often a wait had to give up the thread.
+class VirtualClock : public FS200AC::TimeSource {
+    public:
+    typedef std::chrono::steady_clock::time_point time_point;
+    typedef std::chrono::steady_clock::duration duration;
+
+    explicit VirtualClock(time_point start = time_point())
+        : m_now(start.time_since_epoch().count()), m_sleeps(0) {
+    }
+
+    time_point now() override {
+        return time_point(duration(m_now.load(std::memory_order_acquire)));
+    }
+
+    void sleep_until(time_point time) override {
+        m_sleeps.fetch_add(1, std::memory_order_relaxed);
+        advance_to(time);
+    }
+
+    void advance(duration step) {
+        m_now.fetch_add(step.count(), std::memory_order_acq_rel);
+    }
+
+    // never moves backwards
+    void advance_to(time_point time) {
+        duration::rep target = time.time_since_epoch().count();
+        duration::rep current = m_now.load(std::memory_order_relaxed);
+        while (current < target && !m_now.compare_exchange_weak(current, target, std::memory_order_acq_rel)) {
+        }
+    }
+
+    uint64_t sleeps() const { return m_sleeps.load(std::memory_order_relaxed); }
+
+    private:
+    std::atomic<duration::rep> m_now;
+    std::atomic<uint64_t> m_sleeps;
+};
+
+#endif
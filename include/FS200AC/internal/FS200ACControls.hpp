@@ -1,4 +1,4 @@
-enum Control {
+enum Control : uint8_t {
     NONE = 0,
 
     // knobs
@@ -51,6 +51,9 @@ enum Control {
     TRIM_UP,
     AUTOPILOT_TRIM_DN,
     AUTOPILOT_TRIM_UP,
+
+    // any ID the protocol table does not know, FrameDecoder::frame_data() has the raw ID
+    UNKNOWN = 0x7f,
 };
 
 enum Flaps {
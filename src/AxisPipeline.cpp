@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+
+#include "FS200AC/AxisPipeline.hpp"
+
+using std::chrono::duration;
+
+// smallest range calibration starts from, so the first small movement is not full scale
+static const int CALIBRATION_MIN_RANGE = 32;
+// gaps longer than this restart the filter instead of producing a huge rate
+static const float FILTER_MAX_GAP = 0.25f;
+
+AxisPipeline::AxisConfig::AxisConfig()
+    : deadzone(0.0f), expo(0.0f), invert(false), calibrate(false), alpha(1.0f), beta(0.0f) {
+}
+
+AxisPipeline::AxisPipeline() : m_max_prediction(20000) {
+    std::fill(m_alpha, m_alpha + LANES, 1.0f);
+    std::fill(m_beta, m_beta + LANES, 0.0f);
+    reset();
+}
+
+void AxisPipeline::configure(Axis axis, const AxisConfig &config) {
+    m_config[axis] = config;
+    m_alpha[axis] = std::clamp(config.alpha, 0.0f, 1.0f);
+    m_beta[axis] = std::max(config.beta, 0.0f);
+    m_min[axis] = config.calibrate ? -CALIBRATION_MIN_RANGE : -127;
+    m_max[axis] = config.calibrate ? CALIBRATION_MIN_RANGE : 127;
+    build_table(axis);
+}
+
+void AxisPipeline::reset() {
+    for (int axis = 0; axis < AXES; axis++) {
+        m_min[axis] = m_config[axis].calibrate ? -CALIBRATION_MIN_RANGE : -127;
+        m_max[axis] = m_config[axis].calibrate ? CALIBRATION_MIN_RANGE : 127;
+        build_table(axis);
+    }
+    std::fill(m_value, m_value + LANES, 0.0f);
+    std::fill(m_rate, m_rate + LANES, 0.0f);
+    m_primed = false;
+    m_output = Output();
+}
+
+void AxisPipeline::build_table(int axis) {
+    const AxisConfig &config = m_config[axis];
+    float deadzone = std::clamp(config.deadzone, 0.0f, 0.99f);
+    float expo = std::clamp(config.expo, 0.0f, 1.0f);
+    for (int raw = -128; raw < 128; raw++) {
+        float x = raw < 0 ? (float)raw / -m_min[axis] : (float)raw / m_max[axis];
+        x = std::clamp(x, -1.0f, 1.0f);
+        float magnitude = std::fabs(x);
+        magnitude = magnitude <= deadzone ? 0.0f : (magnitude - deadzone) / (1.0f - deadzone);
+        magnitude = (1.0f - expo) * magnitude + expo * magnitude * magnitude * magnitude;
+        float y = std::copysign(magnitude, x);
+        m_table[axis][(uint8_t)raw] = config.invert ? -y : y;
+    }
+}
+
+const AxisPipeline::Output &AxisPipeline::process(const FS200AC::Sample &sample) {
+    const int8_t raw[AXES] = {sample.roll, sample.pitch, sample.yaw};
+    alignas(16) float measured[LANES] = {};
+    for (int axis = 0; axis < AXES; axis++) {
+        // a new extreme widens the range, which happens a bounded number of times
+        if (m_config[axis].calibrate && (raw[axis] < m_min[axis] || raw[axis] > m_max[axis])) {
+            m_min[axis] = std::min<int>(m_min[axis], raw[axis]);
+            m_max[axis] = std::max<int>(m_max[axis], raw[axis]);
+            build_table(axis);
+        }
+        measured[axis] = m_table[axis][(uint8_t)raw[axis]];
+    }
+
+    float dt = duration<float>(sample.timestamp - m_output.timestamp).count();
+    if (!m_primed || dt <= 0.0f || dt > FILTER_MAX_GAP) {
+        std::copy(measured, measured + LANES, m_value);
+        std::fill(m_rate, m_rate + LANES, 0.0f);
+        m_primed = true;
+    } else {
+        float inv_dt = 1.0f / dt;
+        for (int i = 0; i < LANES; i++) {
+            float predicted = m_value[i] + m_rate[i] * dt;
+            float residual = measured[i] - predicted;
+            m_value[i] = predicted + m_alpha[i] * residual;
+            m_rate[i] += m_beta[i] * residual * inv_dt;
+        }
+    }
+
+    m_output.timestamp = sample.timestamp;
+    for (int axis = 0; axis < AXES; axis++) {
+        m_output.value[axis] = std::clamp(m_value[axis], -1.0f, 1.0f);
+        m_output.rate[axis] = m_rate[axis];
+    }
+    return m_output;
+}
+
+void AxisPipeline::predict(std::chrono::steady_clock::time_point at, float values[AXES]) const {
+    auto ahead = std::clamp<std::chrono::steady_clock::duration>(at - m_output.timestamp,
+        std::chrono::steady_clock::duration::zero(), m_max_prediction);
+    float dt = duration<float>(ahead).count();
+    for (int axis = 0; axis < AXES; axis++) {
+        values[axis] = std::clamp(m_value[axis] + m_rate[axis] * dt, -1.0f, 1.0f);
+    }
+}
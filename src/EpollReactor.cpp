@@ -0,0 +1,91 @@
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "FS200AC/EpollReactor.hpp"
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+
+EpollReactor::EpollReactor() : m_epoll(epoll_create1(EPOLL_CLOEXEC)) {
+    assert(m_epoll >= 0);
+}
+
+EpollReactor::~EpollReactor() {
+    close(m_epoll);
+}
+
+void EpollReactor::wait_readable(int fd, TimePoint deadline, std::coroutine_handle<> handle, bool *readable) {
+    assert(m_readers.find(fd) == m_readers.end());
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd;
+    // one-shot registrations are re-armed with MOD instead of being re-added
+    if (m_registered.insert(fd).second) {
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+    } else {
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &ev);
+    }
+    *readable = false;
+    m_readers[fd] = m_timers.insert({deadline, {fd, handle, readable}});
+}
+
+void EpollReactor::wait_until(TimePoint deadline, std::coroutine_handle<> handle) {
+    m_timers.insert({deadline, {-1, handle, nullptr}});
+}
+
+void EpollReactor::remove(int fd) {
+    if (m_registered.erase(fd)) {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    }
+    auto reader = m_readers.find(fd);
+    if (reader != m_readers.end()) {
+        m_timers.erase(reader->second);
+        m_readers.erase(reader);
+    }
+}
+
+bool EpollReactor::run_once(milliseconds max_wait) {
+    if (m_timers.empty()) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto wait = duration_cast<milliseconds>(m_timers.begin()->first - now);
+    // round up so an expiring timer is not spun on
+    if (m_timers.begin()->first > now + wait) {
+        wait += milliseconds(1);
+    }
+    wait = std::max(milliseconds(0), std::min(wait, max_wait));
+
+    epoll_event events[64];
+    int count = epoll_wait(m_epoll, events, 64, (int)wait.count());
+
+    std::vector<std::coroutine_handle<>> runnable;
+    for (int i = 0; i < count; i++) {
+        auto reader = m_readers.find(events[i].data.fd);
+        if (reader == m_readers.end()) {
+            continue;
+        }
+        *reader->second->second.readable = true;
+        runnable.push_back(reader->second->second.handle);
+        m_timers.erase(reader->second);
+        m_readers.erase(reader);
+    }
+    now = std::chrono::steady_clock::now();
+    while (!m_timers.empty() && m_timers.begin()->first <= now) {
+        auto timer = m_timers.begin();
+        if (timer->second.fd >= 0) {
+            m_readers.erase(timer->second.fd);
+        }
+        runnable.push_back(timer->second.handle);
+        m_timers.erase(timer);
+    }
+    // resume last so coroutines can register new waits while we iterate
+    for (auto handle : runnable) {
+        handle.resume();
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "FS200AC/EventQueue.hpp"
+
+EventQueue::EventQueue(std::size_t capacity)
+    : m_entries(std::max<std::size_t>(capacity, 1)), m_dropped(0), m_coalesced(0) {
+    std::fill(m_policies, m_policies + POLICIES, Policy_KeepAll);
+    m_policies[FS200AC::Slider] = Policy_LatestPerControl;
+    m_policies[FS200AC::Knob] = Policy_LatestPerControl;
+    std::fill(m_range, m_range + CONTROLS, 0);
+    for (FS200AC::Control control : {FS200AC::NAV1_COURSE_SELECTOR, FS200AC::NAV2_OBS, FS200AC::ADF_BRG,
+                                     FS200AC::AUTOPILOT_HEADING}) {
+        m_range[control] = 360;
+    }
+    clear();
+}
+
+void EventQueue::set_policy(FS200AC::EventType type, Policy policy) {
+    m_policies[type] = policy;
+}
+
+void EventQueue::clear() {
+    m_head = m_tail = m_seal = 0;
+    std::fill(m_pending, m_pending + CONTROLS, 0);
+    std::fill(m_has_value, m_has_value + CONTROLS, false);
+}
+
+int32_t EventQueue::value_of(const FS200AC::Event &event) {
+    switch (event.type) {
+        case FS200AC::Slider:
+            return event.slider;
+        case FS200AC::Toggle:
+            return event.toggle;
+        case FS200AC::Switch:
+            return event.switch_;
+        case FS200AC::Knob:
+            return event.knob;
+        default:
+            return 0;
+    }
+}
+
+bool EventQueue::push(const FS200AC::Event &event, std::chrono::steady_clock::time_point timestamp) {
+    if (event.type == FS200AC::None || event.type >= POLICIES) {
+        return true;
+    }
+    std::size_t control = event.control & (CONTROLS - 1);
+    Policy policy = m_policies[event.type];
+    int32_t value = value_of(event);
+    int32_t delta = m_has_value[control] ? value - m_last_value[control] : 0;
+    int32_t range = m_range[control];
+    if (range > 0) {
+        // into [-range / 2, range / 2)
+        delta = ((delta % range) + range + range / 2) % range - range / 2;
+    }
+
+    if (policy != Policy_KeepAll) {
+        uint64_t pending = m_pending[control];
+        if (pending && pending - 1 >= std::max(m_head, m_seal)) {
+            Entry &entry = m_entries[(pending - 1) % m_entries.size()];
+            entry.timestamp = timestamp;
+            entry.event = event;
+            entry.delta += delta;
+            entry.count++;
+            m_coalesced++;
+            m_last_value[control] = value;
+            m_has_value[control] = true;
+            return true;
+        }
+    }
+    // a dropped event leaves the last value alone, its change goes into the next one's delta
+    if (size() == m_entries.size()) {
+        m_dropped++;
+        return false;
+    }
+    m_last_value[control] = value;
+    m_has_value[control] = true;
+    Entry &entry = m_entries[m_tail % m_entries.size()];
+    entry.timestamp = timestamp;
+    entry.event = event;
+    entry.delta = delta;
+    entry.count = 1;
+    m_pending[control] = m_tail + 1;
+    m_tail++;
+    if (policy == Policy_KeepAll) {
+        m_seal = m_tail;
+    }
+    return true;
+}
+
+bool EventQueue::pop(Entry &entry) {
+    if (m_head == m_tail) {
+        return false;
+    }
+    entry = m_entries[m_head % m_entries.size()];
+    m_head++;
+    return true;
+}
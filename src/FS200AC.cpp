@@ -1,76 +1,24 @@
 #include <chrono>
 #include <thread>
 #include <cassert>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
 
 #include "FS200AC/FS200AC.hpp"
+#include "FS200AC/FS200ACTrace.hpp"
 #include "FS200AC/internal/FS200ACInitialState.hpp"
+#include "FS200ACProtocol.hpp"
 
 using std::chrono::duration_cast;
+using std::chrono::microseconds;
 using std::chrono::milliseconds;
 using namespace std::chrono_literals;
 
-typedef std::chrono::steady_clock Clock;
-
-const uint8_t COMMAND_RESET = 0x16;
-const uint8_t CODE_ACKNOWLEDGE = 0x06;
-
-enum EventID {
-    ID_NONE = 0,
-
-    // knobs
-    // uint16_t
-    ID_NAV1_COURSE_SELECTOR = 0x02,
-    ID_NAV2_OBS = 0x04,
-    ID_ADF_BRG = 0x06,
-    ID_BARO = 0x08,
-    ID_AUTOPILOT_HEADING = 0x0a,
-    ID_FREQ_TUNE = 0x0c,
-    // 2x uint8_t
-    ID_FREQ_TUNE_XPNDR = 0x0e, // special handling
-
-    // momentary buttons
-    // no state
-    ID_NAV1_USE_STBY = 0x10,
-    ID_NAV2_USE_STBY = 0x12,
-    ID_ADF_USE_STBY = 0x14,
-    ID_TIMER = 0x42,
-    ID_RMI = 0x44,
-    ID_TRIM = 0x3e, // 2x
-    ID_AUTOPILOT_TRIM = 0x40, // 2x
-    ID_YOKE_SWITCH_DOWN = 0x46,
-    ID_YOKE_SWITCH_UP = 0x48,
-
-    // toggle buttons
-    // 1-bit state
-    ID_NAV1_ON = 0x18,
-    ID_NAV1_ID = 0x1a,
-    ID_NAV1_RAD = 0x1c,
-    ID_NAV2_ON = 0x1e,
-    ID_NAV2_ID = 0x20,
-    ID_NAV2_RAD = 0x22,
-    ID_ADF_ON = 0x24,
-    ID_ADF_ID = 0x26,
-    ID_DME_ON = 0x28,
-    ID_DME_NAV = 0x2a,
-    ID_AUTOPILOT_ON = 0x2c,
-    ID_AUTOPILOT_HDG = 0x2e,
-    ID_AUTOPILOT_ALT = 0x30,
-    ID_FUEL = 0x36,
-
-    // switches
-    // uint8_t
-    ID_GEAR = 0x32,
-    ID_FLAPS = 0x34,
-    ID_FREQ_SELECT_RADIO = 0x16,
-
-    // sliders
-    // uint8_t
-    ID_THROTTLE = 0x38,
-    ID_PROP_RPM = 0x3a,
-    ID_MIXTURE = 0x3c,
-    ID_COWL_FLAP = 0x4a,
-    ID_CARB_HEAT = 0x4c,
-};
+// commands queue_command() holds before it turns more away
+static const std::size_t COMMAND_QUEUE_CAPACITY = 64;
 
 auto retry = [](int count, auto func) {
     for (int i = 0; i < count; i++) {
@@ -78,295 +26,961 @@ auto retry = [](int count, auto func) {
             return true;
         }
     }
-    assert(false);
     return false;
 };
 
-FS200AC::FS200AC(FS200AC::SerialProvider &serial) : m_serial(serial) {
+FS200AC::FS200AC(FS200AC::SerialProvider &serial)
+    : m_serial(serial), m_time(&TimeSource::steady()), m_read_multiplier(0), m_read_timeout(0), m_port_multiplier(~0u), m_port_timeout(~0u),
+      m_pacing(Pacing_Fixed), m_byte_gap(COMMAND_BYTE_GAP), m_timings(), m_reset_on_destroy(true),
+      m_resilient(false), m_probing(false), m_last_error(Error_None),
+      m_rx_pos(m_rx), m_rx_end(m_rx), m_acquiring(false), m_dropped(0), m_sink(nullptr), m_trace(nullptr), m_timeout_overrides(), m_console_valid(false),
+      m_update_state(), m_update_requested(false), m_commands_pending(0), m_outbound_pending(false), m_outbound(),
+      m_outbound_kind(Outbound_None), m_update_sent_state() {
+    update_timeouts();
+}
+
+FS200AC::TimeSource &FS200AC::TimeSource::steady() {
+    class SteadyTimeSource : public TimeSource {
+        public:
+            Clock::time_point now() override { return Clock::now(); }
+            void sleep_until(Clock::time_point time) override { std::this_thread::sleep_until(time); }
+    };
+    static SteadyTimeSource source;
+    return source;
 }
 
 FS200AC::~FS200AC() {
-    reset_console();
+    stop_acquisition();
+    if (m_reset_on_destroy) {
+        // whatever is buffered is stale, and a console that was set up is streaming
+        m_rx_pos = m_rx_end;
+        reset_console(true, m_console_valid.load());
+    }
 }
 
 bool FS200AC::initialize(ControlsState &controls, const ConsoleState &initial_state) {
-    if (!reset_console()) {
-        assert(false);
-        return false;
+    m_timings = InitializeTimings();
+    auto start = m_time->now();
+    if (!reset_console(true, m_console_valid.load())) {
+        return fail(Error_Reset);
     }
+    auto reset = m_time->now();
+    m_timings.reset = duration_cast<microseconds>(reset - start);
     if (!get_controls_state(controls)) {
-        assert(false);
+        return fail(Error_Controls);
+    }
+    auto controls_read = m_time->now();
+    m_timings.controls = duration_cast<microseconds>(controls_read - reset);
+    bool result = setup_console(initial_state) || fail(Error_Setup);
+    reset_live_state(controls, initial_state);
+    auto end = m_time->now();
+    m_timings.setup = duration_cast<microseconds>(end - controls_read);
+    m_timings.total = duration_cast<microseconds>(end - start);
+    if (result) {
+        record_initialize_timings();
+    }
+    return result;
+}
+
+bool FS200AC::reattach() {
+    if (!m_console_valid.load()) {
         return false;
     }
-    return setup_console(initial_state);
+    // a banner that ended the stream already says the console rebooted
+    bool rebooted = m_decoder.banner_pending();
+    // nothing buffered belongs to the console as it is now, and a reopened port
+    // has its own timeouts
+    m_rx_pos = m_rx_end;
+    m_decoder.reset();
+    m_port_multiplier = ~0u;
+    m_port_timeout = ~0u;
+    m_last_ack = Clock::time_point();
+    m_last_frame_start = Clock::time_point();
+    // whatever was being sent went down with the link
+    requeue_outbound();
+    if (!rebooted) {
+        // a console that kept power may be waiting on the ACK for a frame lost with the link
+        if (!write_byte(CODE_ACKNOWLEDGE)) {
+            return report_error(m_serial.connected() ? Error_Write : Error_LinkLost);
+        }
+        // A streaming console answers with a frame, which is left for the next poll.
+        // One that rebooted has sent its banner and then waits; frame data read from
+        // the middle of a frame can hold an 'X' too, but is followed by more frames.
+        // Silence is most likely a reboot whose banner was lost with the link or
+        // inside a cut off frame, so it is treated the same.
+        auto now = m_time->now();
+        auto deadline = now + m_timeouts.frame;
+        bool silent = true;
+        for (;;) {
+            if (m_rx_pos == m_rx_end && !fill_rx_until(deadline, now)) {
+                if (now >= deadline) {
+                    break;
+                }
+                continue;
+            }
+            if (*m_rx_pos == 0xa5) {
+                return true;
+            }
+            rebooted |= *m_rx_pos++ == CODE_BANNER;
+            silent = false;
+        }
+        if (!m_serial.connected()) {
+            return report_error(Error_LinkLost);
+        }
+        rebooted |= silent;
+    }
+    // a console waiting to be set up needs no reset, anything else gets the full initialize()
+    ControlsState controls;
+    ConsoleState console = m_live.console;
+    m_probing = true;
+    bool restored = rebooted && get_controls_state(controls) && setup_console(console);
+    m_probing = false;
+    if (restored) {
+        reset_live_state(controls, console);
+        return true;
+    }
+    return initialize(controls, console);
 }
 
-bool FS200AC::wait_on_code(uint8_t code, int timeout) {
-    auto start = Clock::now();
-    uint8_t value = 0;
-    do {
-        m_serial.read(&value, 1);
-    } while (value != code && duration_cast<milliseconds>(Clock::now() - start).count() < timeout);
-    return value == code;
+bool FS200AC::report_error(Error error) {
+    m_last_error.store(error, std::memory_order_relaxed);
+    if (m_trace && m_trace->wants(FS200ACTrace::Kind_Error)) {
+        m_trace->record_error(m_time->now(), error);
+    }
+    return false;
 }
 
-bool FS200AC::send_command(uint8_t command, bool wait) {
-    m_serial.setWriteTimeout(42);
-    uint8_t bytes[] = {0xa5, command, (uint8_t)(~(command ^ 0xa5) & 0x7f)};
-    for (int i = 0; i < 3; i++) {
-        if (!m_serial.write(&bytes[i], 1)) {
-            assert(false);
+bool FS200AC::fail(Error error) {
+    report_error(error);
+    // outside resilient mode these have always been treated as bugs
+    assert(m_resilient || m_probing);
+    return false;
+}
+
+bool FS200AC::wait_on_code(uint8_t code, milliseconds timeout) {
+    auto now = m_time->now();
+    auto deadline = now + timeout;
+    for (;;) {
+        while (m_rx_pos != m_rx_end) {
+            if (*m_rx_pos++ == code) {
+                return true;
+            }
+        }
+        if (!fill_rx_until(deadline, now) && now >= deadline) {
+            Histogram::bump(m_stats.code_timeouts, 1);
             return false;
         }
-        std::this_thread::sleep_for(42ms);
     }
-    if (wait) {
-        return wait_on_code(CODE_ACKNOWLEDGE, 500);
+}
+
+bool FS200AC::wait_on_response(uint8_t code) {
+    auto start = m_time->now();
+    if (!wait_on_code(code, m_timeouts.response)) {
+        return false;
+    }
+    record_turnaround(m_stats.response, start);
+    return true;
+}
+
+void FS200AC::record_turnaround(Histogram &histogram, Clock::time_point since) {
+    // an answer that was already buffered says nothing about the link
+    if (m_rx_time >= since) {
+        histogram.record(duration_cast<microseconds>(m_rx_time - since));
+        update_timeouts();
+    }
+}
+
+void FS200AC::set_timeouts(const Timeouts &timeouts) {
+    m_timeout_overrides = timeouts;
+    update_timeouts();
+}
+
+static milliseconds measured_timeout(milliseconds override, const Histogram &histogram, const TimeoutRule &rule) {
+    if (override.count() > 0) {
+        return override;
+    }
+    Histogram::Snapshot snapshot = histogram.snapshot();
+    if (snapshot.count < rule.samples) {
+        return rule.fallback;
+    }
+    auto timeout = std::chrono::ceil<milliseconds>(microseconds(2 * snapshot.percentile_us(0.99))) + rule.margin;
+    return std::clamp(timeout, rule.floor, rule.ceiling);
+}
+
+void FS200AC::update_timeouts() {
+    const Timeouts &overrides = m_timeout_overrides;
+    m_timeouts.frame = measured_timeout(overrides.frame, m_stats.turnaround, FRAME_TIMEOUT);
+    m_timeouts.command = measured_timeout(overrides.command, m_stats.command_ack, COMMAND_TIMEOUT);
+    m_timeouts.banner = measured_timeout(overrides.banner, m_stats.command_ack, BANNER_TIMEOUT);
+    m_timeouts.response = measured_timeout(overrides.response, m_stats.response, RESPONSE_TIMEOUT);
+    m_timeouts.reset = measured_timeout(overrides.reset, m_stats.reset, RESET_TIMEOUT);
+}
+
+// learned command byte gaps, shared by every instance talking to the same port
+static std::mutex pacing_mutex;
+static std::map<std::string, unsigned int> pacing_cache;
+
+void FS200AC::set_pacing(Pacing pacing) {
+    m_pacing = pacing;
+    m_byte_gap = COMMAND_BYTE_GAP;
+    if (pacing == Pacing_Adaptive) {
+        m_byte_gap = COMMAND_PROBE_GAP;
+        const char *port = m_serial.port_name();
+        std::lock_guard<std::mutex> lock(pacing_mutex);
+        auto cached = port ? pacing_cache.find(port) : pacing_cache.end();
+        if (cached != pacing_cache.end()) {
+            m_byte_gap = cached->second;
+        }
+    }
+}
+
+unsigned int FS200AC::command_gap(bool wait) const {
+    // commands that are not acknowledged (i.e. reset) give no feedback to learn
+    // from, so they always get the safe gap
+    return wait ? m_byte_gap : COMMAND_BYTE_GAP;
+}
+
+void FS200AC::command_acknowledged() {
+    const char *port = m_serial.port_name();
+    if (m_pacing == Pacing_Adaptive && port) {
+        std::lock_guard<std::mutex> lock(pacing_mutex);
+        pacing_cache[port] = m_byte_gap;
+    }
+}
+
+bool FS200AC::command_missed() {
+    if (m_pacing != Pacing_Adaptive || m_byte_gap >= COMMAND_BYTE_GAP) {
+        // the console is misbehaving at the safe gap, don't trust the cache
+        const char *port = m_serial.port_name();
+        if (port) {
+            std::lock_guard<std::mutex> lock(pacing_mutex);
+            pacing_cache.erase(port);
+        }
+        return false;
     }
+    m_byte_gap = std::min(m_byte_gap * 2, COMMAND_BYTE_GAP);
     return true;
 }
 
-bool FS200AC::reset_console(bool retry) {
-    if (wait_on_code('X', 50)) {
+bool FS200AC::send_command(uint8_t command, bool wait) {
+    m_serial.setWriteTimeout(WRITE_TIMEOUT_PER_BYTE);
+    uint8_t bytes[3];
+    make_command(command, bytes);
+    for (;;) {
+        unsigned int gap = command_gap(wait);
+        Clock::time_point sent;
+        for (int i = 0; i < 3; i++) {
+            if (!write_bytes(&bytes[i], 1)) {
+                return fail(Error_Write);
+            }
+            if (i == 2 && wait) {
+                sent = m_time->now();
+            }
+            // when waiting on the ACK anyway, there is no point pausing after the last byte
+            if (i < 2 || m_pacing == Pacing_Fixed || !wait) {
+                m_time->sleep_for(milliseconds(gap));
+            }
+        }
+        if (!wait) {
+            return true;
+        }
+        if (wait_on_code(CODE_ACKNOWLEDGE, m_timeouts.command)) {
+            record_turnaround(m_stats.command_ack, sent);
+            command_acknowledged();
+            return true;
+        }
+        if (!command_missed()) {
+            return false;
+        }
+    }
+}
+
+bool FS200AC::reset_console(bool retry, bool streaming) {
+    // frame data can contain 'X', only look for a boot banner when idle
+    if (!streaming && wait_on_code(CODE_BANNER, m_timeouts.banner)) {
         return true;
     }
     for (int i = 0; i < 3; i++) {
         send_command(COMMAND_RESET, false);
-        wait_on_code(CODE_ACKNOWLEDGE, 500);
+        wait_on_code(CODE_ACKNOWLEDGE, m_timeouts.command);
     }
-    if (!wait_on_code('X', 500)) {
+    auto start = m_time->now();
+    if (!wait_on_code(CODE_BANNER, m_timeouts.reset)) {
         write_byte(CODE_ACKNOWLEDGE);
-        return reset_console(false);
+        return retry && reset_console(false);
     }
+    record_turnaround(m_stats.reset, start);
     return true;
 }
 
 bool FS200AC::try_get_controls_state(ControlsState &controls) {
-    if (!wait_on_code(0xa5, 440)) {
-        assert(false);
-        return false;
+    if (!wait_on_response(0xa5)) {
+        return fail(Error_Timeout);
     }
-    m_serial.setReadTimeout(42, 440);
+    set_read_timeout(42, (unsigned int)m_timeouts.response.count());
     uint8_t ck = 0;
-    if (!m_serial.read(&ck, 1) ||
-        !m_serial.read((uint8_t*)&controls, sizeof(controls))) {
-        assert(false);
-        return false;
-    }
-    static_assert(sizeof(ControlsState) == 21);
-    for (int i = 0; i < sizeof(controls); i++) {
-        ck ^= ((uint8_t*)&controls)[i];
+    if (!read_byte(ck) ||
+        !read_bytes((uint8_t*)&controls, sizeof(controls))) {
+        return fail(Error_Timeout);
     }
-    controls.major_version -= 48;
-    controls.minor_version -= 48;
     uint8_t checkbyte;
-    if (!m_serial.read(&checkbyte, 1)) {
-        assert(false);
-        return false;
+    if (!read_byte(checkbyte)) {
+        return fail(Error_Timeout);
     }
-    return (ck ^ checkbyte) == 0x7f;
+    return check_controls_state(ck, controls, checkbyte) || report_error(Error_Checksum);
 }
 
 bool FS200AC::get_controls_state(ControlsState &controls) {
     if (!send_command(0x36, true)) {
-        assert(false);
-        return false;
+        return fail(Error_Controls);
     }
     if (!send_command(0x23, true)) {
-        assert(false);
-        return false;
+        return fail(Error_Controls);
     }
     for (int i = 0; i < 3; i++) {
         if (!try_get_controls_state(controls)) {
-            assert(false);
-            return false;
+            return fail(Error_Controls);
         } else {
-            if (m_serial.write(&CODE_ACKNOWLEDGE, 1)) {
+            if (write_byte(CODE_ACKNOWLEDGE)) {
                 return true;
             }
         }
     }
-    assert(false);
-    return false;
+    return fail(Error_Write);
 }
 
 bool FS200AC::setup_console(const ConsoleState &state) {
-    uint8_t buffer[32] = {
-        state.nav1_standby_freq.second, state.nav1_standby_freq.first,
-        state.nav1_current_freq.second, state.nav1_current_freq.first,
+    uint8_t buffer[32];
+    make_setup_packet(state, buffer);
 
-        state.nav2_standby_freq.second, state.nav2_standby_freq.first,
-        state.nav2_current_freq.second, state.nav2_current_freq.first,
+    if (!retry(3, [&]{ return wait_on_response(0xa5) &&
+                                 wait_on_code(0x23, m_timeouts.response) &&
+                                 wait_on_code(0x5c, m_timeouts.response); })) {
+        return fail(Error_Setup);
+    }
+    if (!write_byte(CODE_ACKNOWLEDGE)) {
+        return fail(Error_Write);
+    }
+    m_time->sleep_for(28ms);
+    bool sent = retry(3, [&] {
+        if (!write_byte(0xa5) || !write_byte(0x19) ||
+            !write_bytes(buffer, sizeof(buffer))) {
+            return fail(Error_Write);
+        }
+        if (!wait_on_response(6)) {
+            return false;
+        }
+        console_setup_done(buffer);
+        return true;
+    });
+    return sent || fail(Error_Setup);
+}
 
-        state.adf_standby_freq.second, state.adf_standby_freq.first,
-        state.adf_current_freq.second, state.adf_current_freq.first,
-        state.current_radio,
+void FS200AC::console_setup_done(const uint8_t packet[32]) {
+    memcpy(m_console_packet, packet, sizeof(m_console_packet));
+    // the console was set up from scratch in between
+    requeue_outbound();
+    m_console_valid.store(true);
+}
 
-        (uint8_t)(state.nav1_course_selector & 0x7f),
-        (uint8_t)(state.nav1_course_selector >> 7),
+bool FS200AC::update_console(const ConsoleState &state) {
+    if (!m_console_valid.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_update_mutex);
+    m_update_state = state;
+    m_update_requested.store(true, std::memory_order_release);
+    m_outbound_pending.store(true, std::memory_order_release);
+    return true;
+}
 
-        (uint8_t)(state.nav2_obs & 0x7f),
-        (uint8_t)(state.nav2_obs >> 7),
+bool FS200AC::console_update_pending() const {
+    return m_update_requested.load() || m_outbound_kind.load() == Outbound_Setup;
+}
 
-        (uint8_t)(state.adf_brg & 0x7f),
-        (uint8_t)(state.adf_brg >> 7),
+bool FS200AC::queue_command(uint8_t command) {
+    if (!m_console_valid.load()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_update_mutex);
+    if (m_commands.size() >= COMMAND_QUEUE_CAPACITY) {
+        return false;
+    }
+    m_commands.push_back(command);
+    m_commands_pending.fetch_add(1, std::memory_order_relaxed);
+    m_outbound_pending.store(true, std::memory_order_release);
+    return true;
+}
 
-        (uint8_t)(state.baro & 0x7f),
-        (uint8_t)(state.baro >> 7),
+void FS200AC::service_outbound(Clock::time_point now) {
+    Outbound &out = m_outbound;
+    OutboundKind kind = m_outbound_kind.load(std::memory_order_relaxed);
+    if (kind != Outbound_None) {
+        if (out.written < out.length) {
+            write_outbound(now);
+            return;
+        }
+        bool acknowledged = m_decoder.acknowledgements() != out.acks;
+        if (!acknowledged) {
+            if (now - out.due < (kind == Outbound_Setup ? m_timeouts.response : m_timeouts.command)) {
+                return;
+            }
+            // a missed command slows adaptive pacing down before it is tried again
+            if (kind == Outbound_Command) {
+                command_missed();
+            }
+            if (++out.attempts < 3) {
+                out.written = 0;
+                write_outbound(now);
+                return;
+            }
+        }
+        outbound_done(acknowledged);
+    }
+    if (next_outbound()) {
+        write_outbound(now);
+    }
+}
 
-        (uint8_t)(state.autopilot_hdg & 0x7f),
-        (uint8_t)(state.autopilot_hdg >> 7),
+void FS200AC::write_outbound(Clock::time_point now) {
+    Outbound &out = m_outbound;
+    if (out.paced && now < out.due) {
+        return;
+    }
+    std::size_t count = out.paced ? 1 : out.length - out.written;
+    if (out.written + count == out.length) {
+        out.acks = m_decoder.acknowledgements();
+    }
+    if (!write_bytes(out.bytes + out.written, count)) {
+        // sent again once the console fails to acknowledge it
+        out.written = out.length;
+        out.acks = m_decoder.acknowledgements();
+        out.due = now;
+        return;
+    }
+    out.written += count;
+    if (out.written == out.length) {
+        out.due = m_time->now();
+    } else {
+        out.due = now + milliseconds(command_gap(true));
+    }
+}
 
-        state.unknown_freq.second, state.unknown_freq.first,
-        
-        state.com_freq.second, state.com_freq.first,
+void FS200AC::outbound_done(bool acknowledged) {
+    if (m_outbound_kind.load(std::memory_order_relaxed) == Outbound_Setup) {
+        if (acknowledged) {
+            record_turnaround(m_stats.response, m_outbound.due);
+            memcpy(m_console_packet, m_outbound.bytes + 2, sizeof(m_console_packet));
+            m_live.console = m_update_sent_state;
+            m_live_published.store(m_live);
+        } else {
+            Histogram::bump(m_stats.console_update_failures, 1);
+        }
+    } else {
+        if (acknowledged) {
+            record_turnaround(m_stats.command_ack, m_outbound.due);
+            command_acknowledged();
+        } else {
+            Histogram::bump(m_stats.command_failures, 1);
+        }
+        m_commands_pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+    m_outbound_kind.store(Outbound_None);
+}
 
-        state.unknown[0], state.unknown[1], state.unknown[2], state.unknown[3],
-        0xbc
-    };
-    for (int i = 0; i < 31; i++) {
-        buffer[31] ^= buffer[i];
+bool FS200AC::next_outbound() {
+    Outbound &out = m_outbound;
+    std::unique_lock<std::mutex> lock(m_update_mutex);
+    if (m_update_requested.load(std::memory_order_relaxed)) {
+        m_update_sent_state = m_update_state;
+        m_update_requested.store(false, std::memory_order_relaxed);
+        lock.unlock();
+        out.bytes[0] = 0xa5;
+        out.bytes[1] = 0x19;
+        make_setup_packet(m_update_sent_state, out.bytes + 2);
+        // the protocol has no partial update, so a change anywhere resends the whole packet
+        if (memcmp(out.bytes + 2, m_console_packet, sizeof(m_console_packet)) == 0) {
+            return next_outbound();
+        }
+        out.length = sizeof(out.bytes);
+        out.paced = false;
+        m_outbound_kind.store(Outbound_Setup);
+        Histogram::bump(m_stats.console_updates, 1);
+    } else if (!m_commands.empty()) {
+        make_command(m_commands.front(), out.bytes);
+        m_commands.pop_front();
+        lock.unlock();
+        out.length = 3;
+        out.paced = true;
+        m_outbound_kind.store(Outbound_Command);
+        Histogram::bump(m_stats.commands, 1);
+    } else {
+        // cleared under the lock, so a message queued meanwhile sets it again
+        m_outbound_pending.store(false, std::memory_order_relaxed);
+        return false;
     }
-    buffer[31] = ~buffer[31] & 0x7f;
+    out.written = 0;
+    out.attempts = 0;
+    out.due = Clock::time_point();
+    return true;
+}
 
-    if (!retry(3, [&]{ return wait_on_code(0xa5, 440) &&
-                                 wait_on_code(0x23, 440) &&
-                                 wait_on_code(0x5c, 440); })) {
-        assert(false);
+void FS200AC::requeue_outbound() {
+    OutboundKind kind = m_outbound_kind.load();
+    if (kind == Outbound_None) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_update_mutex);
+    if (kind == Outbound_Setup) {
+        // unless something newer is queued
+        if (!m_update_requested.load()) {
+            m_update_state = m_update_sent_state;
+            m_update_requested.store(true);
+        }
+    } else {
+        m_commands.push_front(m_outbound.bytes[1]);
+    }
+    m_outbound_kind.store(Outbound_None);
+    m_outbound_pending.store(true);
+}
+
+bool FS200AC::write_byte(uint8_t b) {
+    return write_bytes(&b, 1);
+}
+
+bool FS200AC::write_bytes(const uint8_t *bytes, std::size_t count) {
+    if (!m_serial.write(bytes, count)) {
         return false;
     }
-    if (!write_byte(CODE_ACKNOWLEDGE)) {
-        assert(false);
+    trace_write(bytes, count);
+    return true;
+}
+
+void FS200AC::trace_write(const uint8_t *bytes, std::size_t count) {
+    if (m_trace && m_trace->wants(FS200ACTrace::Kind_Write)) {
+        m_trace->record_bytes(FS200ACTrace::Kind_Write, m_time->now(), bytes, count);
+    }
+}
+
+void FS200AC::set_read_timeout(unsigned int multiplier, unsigned int timeout_ms) {
+    m_read_multiplier = multiplier;
+    m_read_timeout = timeout_ms;
+    apply_read_timeout(multiplier, timeout_ms);
+}
+
+void FS200AC::apply_read_timeout(unsigned int multiplier, unsigned int timeout_ms) {
+    if (multiplier != m_port_multiplier || timeout_ms != m_port_timeout) {
+        m_port_multiplier = multiplier;
+        m_port_timeout = timeout_ms;
+        m_serial.setReadTimeout(multiplier, timeout_ms);
+    }
+}
+
+bool FS200AC::fill_rx() {
+    std::size_t count;
+    if (const uint8_t *view = m_serial.read_view(count)) {
+        m_rx_pos = view;
+        m_rx_end = view + count;
+    } else {
+        count = m_serial.read_some(m_rx, sizeof(m_rx));
+        m_rx_pos = m_rx;
+        m_rx_end = m_rx + count;
+    }
+    if (count == 0) {
         return false;
     }
-    std::this_thread::sleep_for(28ms);
-    return retry(3, [&] {
-        if (!write_byte(0xa5) || !write_byte(0x19)) {
-            assert(false);
-            return false;
-        }
-        if (!m_serial.write(buffer, sizeof(buffer))) {
-            assert(false);
+    m_rx_time = m_time->now();
+    if (m_trace && m_trace->wants(FS200ACTrace::Kind_Read)) {
+        m_trace->record_bytes(FS200ACTrace::Kind_Read, m_rx_time, m_rx_pos, count);
+    }
+    return true;
+}
+
+bool FS200AC::fill_rx_until(Clock::time_point deadline, Clock::time_point &now) {
+    bool waiting = now < deadline;
+    apply_read_timeout(0, waiting ? (unsigned int)std::chrono::ceil<milliseconds>(deadline - now).count() : 0);
+    if (fill_rx()) {
+        now = m_rx_time;
+        return true;
+    }
+    if (!waiting) {
+        return false;
+    }
+    if (!m_serial.connected()) {
+        now = deadline;
+        return false;
+    }
+    // providers that return before their timeout must not turn the wait into a spin
+    now = m_time->now();
+    if (now < deadline) {
+        m_time->sleep_until(std::min(now + 1ms, deadline));
+        now = m_time->now();
+    }
+    return false;
+}
+
+bool FS200AC::read_byte(uint8_t &b) {
+    if (m_rx_pos == m_rx_end) {
+        apply_read_timeout(m_read_multiplier, m_read_timeout);
+        if (!fill_rx()) {
             return false;
         }
-        return wait_on_code(6, 440);
-    });
+    }
+    b = *m_rx_pos++;
+    return true;
 }
 
-bool FS200AC::write_byte(uint8_t b) {
-    return m_serial.write(&b, 1);
+bool FS200AC::read_bytes(uint8_t *buffer, std::size_t count) {
+    // drain whatever is already buffered before going to the port
+    std::size_t buffered = std::min<std::size_t>(m_rx_end - m_rx_pos, count);
+    std::copy(m_rx_pos, m_rx_pos + buffered, buffer);
+    m_rx_pos += buffered;
+    if (buffered == count) {
+        return true;
+    }
+    apply_read_timeout(m_read_multiplier, m_read_timeout);
+    if (!m_serial.read(buffer + buffered, count - buffered)) {
+        return false;
+    }
+    if (m_trace && m_trace->wants(FS200ACTrace::Kind_Read)) {
+        m_trace->record_bytes(FS200ACTrace::Kind_Read, m_time->now(), buffer + buffered, count - buffered);
+    }
+    return true;
 }
 
-void FS200AC::fill_event(Event &event, uint8_t id, uint8_t b2, uint8_t b3) {
-    event.control = (Control)id;
-    if (!id) {
-        event.type = None;
-        return;
+bool FS200AC::fill_event(Event &event, uint8_t id, uint8_t b2, uint8_t b3) {
+    const EventDecoder &d = EVENT_DECODERS[id & 0x7f];
+    uint16_t value = (uint16_t)(((b2 & d.b2_mask) << d.b2_shift) | ((b3 & d.b3_mask) << d.b3_shift));
+    event.type = d.type;
+    event.control = (Control)(d.control + ((b2 - 1) & d.control_mask));
+    if (d.wide) {
+        event.knob = value;
+    } else if (d.boolean) {
+        event.toggle = value != 0;
+    } else {
+        event.slider = (uint8_t)value;
     }
-    switch (id) {
-        // momentary switches, map these to buttons
-        case ID_TRIM:
-            event.type = Button;
-            event.control = (Control)(Control::TRIM_DN + b2 - 1);
-            break;
-        case ID_AUTOPILOT_TRIM:
-            event.type = Button;
-            event.control = (Control)(Control::AUTOPILOT_TRIM_DN + b2 - 1);
-            break;
+    return d.known;
+}
 
-        // knobs
-        case ID_NAV1_COURSE_SELECTOR:
-        case ID_NAV2_OBS:
-        case ID_ADF_BRG:
-        case ID_BARO:
-        case ID_AUTOPILOT_HEADING:
-        case ID_FREQ_TUNE:
-            event.type = Knob;
-            event.knob = ((uint16_t)b3 << 7) | b2;
-            break;
-        case ID_FREQ_TUNE_XPNDR:
-            event.type = Knob;
-            event.control = FREQ_TUNE_RADIO;
-            event.knob = ((b2 & 3) << 8) | b3;
-            break;
+const char *FS200AC::control_name(Control control) {
+    return (unsigned int)control < CONTROL_NAMES.size() ? CONTROL_NAMES[control] : nullptr;
+}
 
-        // push buttons
-        case ID_NAV1_USE_STBY:
-        case ID_NAV2_USE_STBY:
-        case ID_ADF_USE_STBY:
-        case ID_TIMER:
-        case ID_RMI:
-        case ID_YOKE_SWITCH_DOWN:
-        case ID_YOKE_SWITCH_UP:
-            event.type = Button;
-            break;
+FS200AC::FrameDecoder::FrameDecoder() : m_unknown_events(0), m_skipped_bytes(0), m_acknowledgements(0), m_restarts(0) {
+    reset();
+}
 
-        // toggles
-        case ID_NAV1_ON:
-        case ID_NAV1_ID:
-        case ID_NAV1_RAD:
-        case ID_NAV2_ON:
-        case ID_NAV2_ID:
-        case ID_NAV2_RAD:
-        case ID_ADF_ON:
-        case ID_ADF_ID:
-        case ID_DME_ON:
-        case ID_DME_NAV:
-        case ID_AUTOPILOT_ON:
-        case ID_AUTOPILOT_HDG:
-        case ID_AUTOPILOT_ALT:
-        case ID_FUEL:
-            event.type = Toggle;
-            event.toggle = (bool)b2;
-            break;
+void FS200AC::FrameDecoder::reset() {
+    m_count = 0;
+    m_ck = 0;
+    m_in_frame = false;
+    m_banner = false;
+}
 
+void FS200AC::FrameDecoder::restart() {
+    // frame bytes are all 7-bit, so a start byte among them means the rest of
+    // this frame was lost and a new one began there
+    for (int i = sizeof(m_buffer) - 1; i >= 0; i--) {
+        if (m_buffer[i] == 0xa5) {
+            m_count = (uint8_t)(sizeof(m_buffer) - 1 - i);
+            memmove(m_buffer, m_buffer + i + 1, m_count);
+            m_ck = 0;
+            for (int j = 0; j < m_count; j++) {
+                m_ck ^= m_buffer[j];
+            }
+            m_restarts++;
+            return;
+        }
+    }
+    reset();
+}
 
-        // logically treated as a switch
-        case ID_FREQ_SELECT_RADIO:
-        // mechanical switches
-        case ID_GEAR:
-        case ID_FLAPS:
-            event.type = Switch;
-            event.switch_ = b2;
-            break;
+FS200AC::FrameDecoder::Status FS200AC::decode_rx(FrameDecoder::Frame &frame) {
+    // a frame that starts during this call has its start byte in the current window
+    if (!m_decoder.in_frame()) {
+        m_frame_start = m_rx_time;
+    }
+    FrameDecoder::Status status = m_decoder.decode(m_rx_pos, m_rx_end, frame);
+    if (status == FrameDecoder::ChecksumError) {
+        Histogram::bump(m_stats.checksum_errors, 1);
+        report_error(Error_Checksum);
+    }
+    m_stats.resync_bytes.store(m_decoder.skipped_bytes(), std::memory_order_relaxed);
+    m_stats.restarted_frames.store(m_decoder.restarts(), std::memory_order_relaxed);
+    m_stats.unknown_events.store(m_decoder.unknown_events(), std::memory_order_relaxed);
+    return status;
+}
 
-        // sliders
-        case ID_THROTTLE:
-        case ID_PROP_RPM:
-        case ID_MIXTURE:
-        case ID_COWL_FLAP:
-        case ID_CARB_HEAT:
-            event.type = Slider;
-            event.slider = b2;
-            break;
-        default:
-            assert(false);
-            break;
+void FS200AC::frame_timed_out() {
+    if (!m_serial.connected()) {
+        report_error(Error_LinkLost);
+    } else if (m_decoder.banner_pending()) {
+        report_error(Error_Rebooted);
+    } else if (m_decoder.in_frame()) {
+        Histogram::bump(m_stats.partial_frames, 1);
+        report_error(Error_PartialFrame);
+    } else {
+        Histogram::bump(m_stats.frame_timeouts, 1);
+        report_error(Error_Timeout);
+    }
+    // a console that stopped streaming may be waiting on a queued command
+    if (m_outbound_pending.load(std::memory_order_relaxed)) {
+        service_outbound(m_time->now());
     }
 }
 
-bool FS200AC::poll(int8_t &roll, int8_t &pitch, int8_t &yaw, Event &event) {
-    if (!wait_on_code(0xa5, 100)) {
-        return false;
+bool FS200AC::acknowledge(const FrameDecoder::Frame &frame, Sample &sample) {
+    auto ack_start = m_time->now();
+    // not traced as a write, the frame entry stands for it
+    if (!m_serial.write(&CODE_ACKNOWLEDGE, 1)) {
+        Histogram::bump(m_stats.ack_failures, 1);
+        return report_error(Error_Write);
     }
-    uint8_t buff[8];
-    uint8_t ck = 0;
-    for (int i = 0; i < 8; i++) {
-        if (!m_serial.read(&buff[i], 1)) {
+    sample.timestamp = m_time->now();
+    m_stats.ack_write.record(duration_cast<microseconds>(sample.timestamp - ack_start));
+    m_stats.delivery.record(duration_cast<microseconds>(sample.timestamp - m_frame_start));
+    if (m_last_frame_start != Clock::time_point()) {
+        m_stats.frame_gap.record(duration_cast<microseconds>(m_frame_start - m_last_frame_start));
+    }
+    m_last_frame_start = m_frame_start;
+    if (m_last_ack != Clock::time_point() && m_frame_start >= m_last_ack) {
+        m_stats.turnaround.record(duration_cast<microseconds>(m_frame_start - m_last_ack));
+    }
+    m_last_ack = sample.timestamp;
+    uint64_t frames = m_stats.frames.load(std::memory_order_relaxed) + 1;
+    m_stats.frames.store(frames, std::memory_order_relaxed);
+    // the percentiles move slowly, no need to look at them every frame
+    if (frames % 64 == 0) {
+        update_timeouts();
+    }
+    sample.event = frame.event;
+    sample.roll = frame.roll;
+    sample.pitch = frame.pitch;
+    sample.yaw = frame.yaw;
+    update_live_state(sample);
+    if (m_trace && m_trace->wants(FS200ACTrace::Kind_Frame)) {
+        m_trace->record_frame(sample, m_decoder.frame_data());
+    }
+    if (m_sink) {
+        m_sink->on_sample(sample, m_live);
+    }
+    // the ACK above always goes out ahead of anything queued
+    if (m_outbound_pending.load(std::memory_order_relaxed)) {
+        service_outbound(sample.timestamp);
+    }
+    return true;
+}
+
+bool FS200AC::read_frame(Sample &sample, milliseconds timeout) {
+    auto now = m_time->now();
+    auto deadline = now + timeout;
+    FrameDecoder::Frame frame;
+    for (;;) {
+        if (m_rx_pos == m_rx_end && !fill_rx_until(deadline, now)) {
+            // the rest of a partial frame may still arrive while there is time left
+            if (now < deadline) {
+                continue;
+            }
+            // a partial frame that stops arriving is an error, as is not seeing one at all
+            frame_timed_out();
+            if (m_resilient) {
+                // the next call starts clean instead of finishing a stale frame
+                m_decoder.reset();
+            }
             return false;
         }
-        ck ^= buff[i];
+        switch (decode_rx(frame)) {
+            case FrameDecoder::NeedMore:
+                break;
+            case FrameDecoder::ChecksumError:
+                if (!m_resilient || m_time->now() >= deadline) {
+                    return false;
+                }
+                break;
+            case FrameDecoder::FrameReady:
+                return acknowledge(frame, sample);
+        }
     }
-    if (ck != 0x7f) {
+}
+
+bool FS200AC::poll(int8_t &roll, int8_t &pitch, int8_t &yaw, Event &event) {
+    Sample sample;
+    if (!read_frame(sample, m_timeouts.frame)) {
         return false;
     }
-    if (!write_byte(CODE_ACKNOWLEDGE)) {
+    roll = sample.roll;
+    pitch = sample.pitch;
+    yaw = sample.yaw;
+    event = sample.event;
+    return true;
+}
+
+std::size_t FS200AC::poll_batch(std::span<Sample> out, Clock::time_point deadline) {
+    std::size_t count = 0;
+    auto now = m_time->now();
+    FrameDecoder::Frame frame;
+    while (count < out.size()) {
+        if (m_rx_pos == m_rx_end) {
+            // once there is something to return only take what is already waiting
+            if (!fill_rx_until(count ? Clock::time_point() : deadline, now)) {
+                if (count || now >= deadline) {
+                    if (!count) {
+                        frame_timed_out();
+                    }
+                    break;
+                }
+                continue;
+            }
+        }
+        if (decode_rx(frame) != FrameDecoder::FrameReady) {
+            continue;
+        }
+        if (!acknowledge(frame, out[count])) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+bool FS200AC::start_acquisition(std::size_t capacity) {
+    if (m_acquiring.load()) {
         return false;
     }
-    roll = (int8_t)((buff[0] & 2) ? -buff[2] : buff[2]);
-    pitch = (int8_t)((buff[0] & 1) ? -buff[1] : buff[1]);
-    yaw = (int8_t)((buff[0] & 4) ? -buff[3] : buff[3]);
-    fill_event(event, buff[4], buff[5], buff[6]);
+    m_samples.reset(new SPSCRing<Sample>(capacity));
+    m_dropped.store(0);
+    m_acquiring.store(true);
+    m_acquisition = std::thread(&FS200AC::acquisition_loop, this);
     return true;
 }
 
+void FS200AC::stop_acquisition() {
+    m_acquiring.store(false);
+    if (m_acquisition.joinable()) {
+        m_acquisition.join();
+    }
+}
+
+bool FS200AC::pop_sample(Sample &sample) {
+    return m_samples && m_samples->pop(sample);
+}
+
+std::size_t FS200AC::pop_samples(Sample *samples, std::size_t count) {
+    return m_samples ? m_samples->pop(samples, count) : 0;
+}
+
+void FS200AC::acquisition_loop() {
+    Sample sample;
+    while (m_acquiring.load(std::memory_order_relaxed)) {
+        if (!read_frame(sample, m_timeouts.frame)) {
+            continue;
+        }
+        if (!m_samples->push(sample)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void FS200AC::record_initialize_timings() {
+    m_stats.initialize_reset.record(m_timings.reset);
+    m_stats.initialize_controls.record(m_timings.controls);
+    m_stats.initialize_setup.record(m_timings.setup);
+    m_stats.initialize_total.record(m_timings.total);
+}
+
+FS200AC::Stats FS200AC::stats() const {
+    Stats stats;
+    stats.frames = m_stats.frames.load(std::memory_order_relaxed);
+    stats.checksum_errors = m_stats.checksum_errors.load(std::memory_order_relaxed);
+    stats.partial_frames = m_stats.partial_frames.load(std::memory_order_relaxed);
+    stats.resync_bytes = m_stats.resync_bytes.load(std::memory_order_relaxed);
+    stats.restarted_frames = m_stats.restarted_frames.load(std::memory_order_relaxed);
+    stats.unknown_events = m_stats.unknown_events.load(std::memory_order_relaxed);
+    stats.frame_timeouts = m_stats.frame_timeouts.load(std::memory_order_relaxed);
+    stats.code_timeouts = m_stats.code_timeouts.load(std::memory_order_relaxed);
+    stats.ack_failures = m_stats.ack_failures.load(std::memory_order_relaxed);
+    stats.console_updates = m_stats.console_updates.load(std::memory_order_relaxed);
+    stats.console_update_failures = m_stats.console_update_failures.load(std::memory_order_relaxed);
+    stats.commands = m_stats.commands.load(std::memory_order_relaxed);
+    stats.command_failures = m_stats.command_failures.load(std::memory_order_relaxed);
+    stats.frame_gap = m_stats.frame_gap.snapshot();
+    stats.turnaround = m_stats.turnaround.snapshot();
+    stats.command_ack = m_stats.command_ack.snapshot();
+    stats.response = m_stats.response.snapshot();
+    stats.reset = m_stats.reset.snapshot();
+    stats.delivery = m_stats.delivery.snapshot();
+    stats.ack_write = m_stats.ack_write.snapshot();
+    stats.initialize_reset = m_stats.initialize_reset.snapshot();
+    stats.initialize_controls = m_stats.initialize_controls.snapshot();
+    stats.initialize_setup = m_stats.initialize_setup.snapshot();
+    stats.initialize_total = m_stats.initialize_total.snapshot();
+    return stats;
+}
+
+FS200AC::LiveState FS200AC::live_state() const {
+    return m_live_published.load();
+}
+
+void FS200AC::reset_live_state(const ControlsState &controls, const ConsoleState &console) {
+    m_live = LiveState();
+    m_live.controls = controls;
+    m_live.console = console;
+    m_live.timestamp = m_time->now();
+    m_live_published.store(m_live);
+}
+
+void FS200AC::update_live_state(const Sample &sample) {
+    LiveState &live = m_live;
+    live.roll = sample.roll;
+    live.pitch = sample.pitch;
+    live.yaw = sample.yaw;
+    live.frames++;
+    live.timestamp = sample.timestamp;
+
+    const Event &event = sample.event;
+    const LiveField &field = LIVE_FIELDS[event.control & 0x7f];
+    uint8_t *base = (uint8_t*)&live;
+    switch (field.kind) {
+        case LiveField_None:
+            break;
+        case LiveField_Byte:
+            base[field.offset] = event.type == Toggle ? event.toggle : event.slider;
+            break;
+        case LiveField_Word:
+            std::memcpy(base + field.offset, &event.knob, sizeof(uint16_t));
+            break;
+        case LiveField_Frequency:
+            tune_radio(live, event.knob);
+            break;
+        case LiveField_Swap: {
+            // "use standby" exchanges the standby and active frequencies
+            ConsoleState::RadioFrequency *standby = (ConsoleState::RadioFrequency*)(base + field.offset);
+            std::swap(standby[0], standby[1]);
+            break;
+        }
+    }
+    m_live_published.store(live);
+}
+
+void FS200AC::tune_radio(LiveState &live, uint16_t value) {
+    // the tuning knob reports the standby frequency of the selected radio
+    ConsoleState &console = live.console;
+    switch (console.current_radio) {
+        case Radio_NAV1:
+            console.nav1_standby_freq = {(uint8_t)(value / 100), (uint8_t)(value % 100)};
+            break;
+        case Radio_NAV2:
+            console.nav2_standby_freq = {(uint8_t)(value / 100), (uint8_t)(value % 100)};
+            break;
+        case Radio_ADF:
+            console.adf_standby_freq = {(uint8_t)(value / 10), (uint8_t)(value % 10)};
+            break;
+        case Radio_COM:
+            console.com_freq = {(uint8_t)(value / 100), (uint8_t)(value % 100)};
+            break;
+        case Radio_XPNDR:
+            live.xpndr = value;
+            break;
+    }
+}
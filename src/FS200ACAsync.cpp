@@ -0,0 +1,280 @@
+#include <algorithm>
+
+#include "FS200AC/FS200AC.hpp"
+#include "FS200ACProtocol.hpp"
+
+// Coroutine mirror of the blocking protocol code in FS200AC.cpp. The wire format,
+// timeouts, pacing, statistics and what a reply means are shared with it; only the
+// sequencing is repeated here, so that reads and writes wait on the reactor rather
+// than in the provider. Keep the two sequences in step.
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using namespace std::chrono_literals;
+
+Task<bool> FS200AC::fill_rx_async(Reactor &reactor, Clock::time_point deadline) {
+    int fd = m_serial.native_handle();
+    // all the waiting is done on the reactor, a read that blocked in the provider
+    // would hold up every other coroutine on it
+    apply_read_timeout(0, 0);
+    for (;;) {
+        if (fd >= 0 && !co_await reactor.readable(fd, deadline)) {
+            co_return false;
+        }
+        if (fill_rx()) {
+            co_return true;
+        }
+        auto now = Clock::now();
+        if (now >= deadline || !m_serial.connected()) {
+            co_return false;
+        }
+        // readable but empty (e.g. a hung up tty), or nothing to wait on at all
+        co_await reactor.sleep_until(std::min(now + 1ms, deadline));
+    }
+}
+
+Task<bool> FS200AC::read_bytes_async(Reactor &reactor, uint8_t *buffer, std::size_t count, milliseconds timeout) {
+    auto deadline = Clock::now() + timeout;
+    while (count) {
+        if (m_rx_pos == m_rx_end && !co_await fill_rx_async(reactor, deadline)) {
+            co_return false;
+        }
+        std::size_t n = std::min<std::size_t>(m_rx_end - m_rx_pos, count);
+        std::copy(m_rx_pos, m_rx_pos + n, buffer);
+        m_rx_pos += n;
+        buffer += n;
+        count -= n;
+    }
+    co_return true;
+}
+
+Task<bool> FS200AC::write_bytes_async(Reactor &reactor, const uint8_t *bytes, std::size_t count) {
+    auto deadline = Clock::now() + milliseconds(WRITE_TIMEOUT_PER_BYTE * count);
+    std::size_t written = 0;
+    for (;;) {
+        written += m_serial.write_some(bytes + written, count - written);
+        if (written == count) {
+            break;
+        }
+        auto now = Clock::now();
+        if (now >= deadline || !m_serial.connected()) {
+            co_return false;
+        }
+        // the reactor only waits for reads, a full output buffer drains within a byte time
+        co_await reactor.sleep_until(std::min(now + 1ms, deadline));
+    }
+    trace_write(bytes, count);
+    co_return true;
+}
+
+Task<bool> FS200AC::wait_on_code_async(Reactor &reactor, uint8_t code, milliseconds timeout) {
+    auto deadline = Clock::now() + timeout;
+    for (;;) {
+        while (m_rx_pos != m_rx_end) {
+            if (*m_rx_pos++ == code) {
+                co_return true;
+            }
+        }
+        if (!co_await fill_rx_async(reactor, deadline)) {
+            Histogram::bump(m_stats.code_timeouts, 1);
+            co_return false;
+        }
+    }
+}
+
+Task<bool> FS200AC::wait_on_response_async(Reactor &reactor, uint8_t code) {
+    auto start = Clock::now();
+    if (!co_await wait_on_code_async(reactor, code, m_timeouts.response)) {
+        co_return false;
+    }
+    record_turnaround(m_stats.response, start);
+    co_return true;
+}
+
+Task<bool> FS200AC::send_command_async(Reactor &reactor, uint8_t command, bool wait) {
+    uint8_t bytes[3];
+    make_command(command, bytes);
+    for (;;) {
+        unsigned int gap = command_gap(wait);
+        Clock::time_point sent;
+        for (int i = 0; i < 3; i++) {
+            if (!co_await write_bytes_async(reactor, &bytes[i], 1)) {
+                co_return fail(Error_Write);
+            }
+            if (i == 2 && wait) {
+                sent = Clock::now();
+            }
+            if (i < 2 || m_pacing == Pacing_Fixed || !wait) {
+                co_await reactor.sleep_for(milliseconds(gap));
+            }
+        }
+        if (!wait) {
+            co_return true;
+        }
+        if (co_await wait_on_code_async(reactor, CODE_ACKNOWLEDGE, m_timeouts.command)) {
+            record_turnaround(m_stats.command_ack, sent);
+            command_acknowledged();
+            co_return true;
+        }
+        if (!command_missed()) {
+            co_return false;
+        }
+    }
+}
+
+Task<bool> FS200AC::reset_console_async(Reactor &reactor, bool retry, bool streaming) {
+    // frame data can contain 'X', only look for a boot banner when idle
+    if (!streaming && co_await wait_on_code_async(reactor, CODE_BANNER, m_timeouts.banner)) {
+        co_return true;
+    }
+    for (int i = 0; i < 3; i++) {
+        co_await send_command_async(reactor, COMMAND_RESET, false);
+        co_await wait_on_code_async(reactor, CODE_ACKNOWLEDGE, m_timeouts.command);
+    }
+    auto start = Clock::now();
+    if (!co_await wait_on_code_async(reactor, CODE_BANNER, m_timeouts.reset)) {
+        co_await write_bytes_async(reactor, &CODE_ACKNOWLEDGE, 1);
+        co_return retry && co_await reset_console_async(reactor, false);
+    }
+    record_turnaround(m_stats.reset, start);
+    co_return true;
+}
+
+Task<bool> FS200AC::try_get_controls_state_async(Reactor &reactor, ControlsState &controls) {
+    if (!co_await wait_on_response_async(reactor, 0xa5)) {
+        co_return fail(Error_Timeout);
+    }
+    uint8_t ck = 0;
+    uint8_t checkbyte = 0;
+    if (!co_await read_bytes_async(reactor, &ck, 1, m_timeouts.response) ||
+        !co_await read_bytes_async(reactor, (uint8_t*)&controls, sizeof(controls), m_timeouts.response) ||
+        !co_await read_bytes_async(reactor, &checkbyte, 1, m_timeouts.response)) {
+        co_return fail(Error_Timeout);
+    }
+    co_return check_controls_state(ck, controls, checkbyte) || report_error(Error_Checksum);
+}
+
+Task<bool> FS200AC::get_controls_state_async(Reactor &reactor, ControlsState &controls) {
+    if (!co_await send_command_async(reactor, 0x36, true)) {
+        co_return fail(Error_Controls);
+    }
+    if (!co_await send_command_async(reactor, 0x23, true)) {
+        co_return fail(Error_Controls);
+    }
+    for (int i = 0; i < 3; i++) {
+        if (!co_await try_get_controls_state_async(reactor, controls)) {
+            co_return fail(Error_Controls);
+        } else {
+            if (co_await write_bytes_async(reactor, &CODE_ACKNOWLEDGE, 1)) {
+                co_return true;
+            }
+        }
+    }
+    co_return fail(Error_Write);
+}
+
+Task<bool> FS200AC::setup_console_async(Reactor &reactor, const ConsoleState &state) {
+    uint8_t buffer[32];
+    make_setup_packet(state, buffer);
+
+    bool requested = false;
+    for (int i = 0; i < 3 && !requested; i++) {
+        requested = co_await wait_on_response_async(reactor, 0xa5) &&
+                    co_await wait_on_code_async(reactor, 0x23, m_timeouts.response) &&
+                    co_await wait_on_code_async(reactor, 0x5c, m_timeouts.response);
+    }
+    if (!requested) {
+        co_return fail(Error_Setup);
+    }
+    if (!co_await write_bytes_async(reactor, &CODE_ACKNOWLEDGE, 1)) {
+        co_return fail(Error_Write);
+    }
+    co_await reactor.sleep_for(28ms);
+    const uint8_t header[2] = {0xa5, 0x19};
+    for (int i = 0; i < 3; i++) {
+        if (!co_await write_bytes_async(reactor, &header[0], 1) ||
+            !co_await write_bytes_async(reactor, &header[1], 1) ||
+            !co_await write_bytes_async(reactor, buffer, sizeof(buffer))) {
+            co_return fail(Error_Write);
+        }
+        if (co_await wait_on_response_async(reactor, 6)) {
+            console_setup_done(buffer);
+            co_return true;
+        }
+    }
+    co_return fail(Error_Setup);
+}
+
+Task<bool> FS200AC::initialize_async(Reactor &reactor, ControlsState &controls, const ConsoleState &initial_state) {
+    m_timings = InitializeTimings();
+    auto start = Clock::now();
+    if (!co_await reset_console_async(reactor, true, m_console_valid.load())) {
+        co_return fail(Error_Reset);
+    }
+    auto reset = Clock::now();
+    m_timings.reset = duration_cast<microseconds>(reset - start);
+    if (!co_await get_controls_state_async(reactor, controls)) {
+        co_return fail(Error_Controls);
+    }
+    auto controls_read = Clock::now();
+    m_timings.controls = duration_cast<microseconds>(controls_read - reset);
+    bool result = co_await setup_console_async(reactor, initial_state) || fail(Error_Setup);
+    reset_live_state(controls, initial_state);
+    auto end = Clock::now();
+    m_timings.setup = duration_cast<microseconds>(end - controls_read);
+    m_timings.total = duration_cast<microseconds>(end - start);
+    if (result) {
+        record_initialize_timings();
+    }
+    co_return result;
+}
+
+Task<bool> FS200AC::read_frame_async(Reactor &reactor, Sample &sample, milliseconds timeout) {
+    auto deadline = Clock::now() + timeout;
+    FrameDecoder::Frame frame;
+    for (;;) {
+        if (m_rx_pos == m_rx_end && !co_await fill_rx_async(reactor, deadline)) {
+            frame_timed_out();
+            if (m_resilient) {
+                // the next call starts clean instead of finishing a stale frame
+                m_decoder.reset();
+            }
+            co_return false;
+        }
+        switch (decode_rx(frame)) {
+            case FrameDecoder::NeedMore:
+                break;
+            case FrameDecoder::ChecksumError:
+                if (!m_resilient || Clock::now() >= deadline) {
+                    co_return false;
+                }
+                break;
+            case FrameDecoder::FrameReady:
+                co_return acknowledge(frame, sample);
+        }
+    }
+}
+
+Task<bool> FS200AC::poll_async(Reactor &reactor, Sample &sample) {
+    co_return co_await read_frame_async(reactor, sample, m_timeouts.frame);
+}
+
+Task<bool> FS200AC::shutdown_async(Reactor &reactor) {
+    m_reset_on_destroy = false;
+    m_rx_pos = m_rx_end;
+    co_return co_await reset_console_async(reactor, true, true);
+}
+
+AsyncGenerator<FS200AC::Sample> FS200AC::poll_stream(Reactor &reactor) {
+    Sample sample;
+    for (;;) {
+        if (co_await poll_async(reactor, sample)) {
+            co_yield sample;
+        } else if (!m_serial.connected()) {
+            // nothing more can arrive, polling on would only spin
+            report_error(Error_LinkLost);
+            co_return;
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstring>
+
+#include "FS200AC/FS200ACCapture.hpp"
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+typedef std::chrono::steady_clock Clock;
+
+template<typename C>
+static int64_t nanoseconds_since_epoch() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(C::now().time_since_epoch()).count();
+}
+
+CaptureProvider::CaptureProvider(FS200AC::SerialProvider &serial, const char *path)
+    : m_serial(serial), m_file(fopen(path, "a+b")), m_read_multiplier(0), m_read_timeout(0) {
+    if (!m_file) {
+        return;
+    }
+    fseek(m_file, 0, SEEK_END);
+    if (ftell(m_file) == 0) {
+        Header header;
+        header.steady_ns = nanoseconds_since_epoch<std::chrono::steady_clock>();
+        header.system_ns = nanoseconds_since_epoch<std::chrono::system_clock>();
+        fwrite(MAGIC, sizeof(MAGIC), 1, m_file);
+        fwrite(&header, sizeof(header), 1, m_file);
+        return;
+    }
+    // appending to an existing capture keeps its header, records in another format would not replay
+    char magic[sizeof(MAGIC)];
+    rewind(m_file);
+    if (fread(magic, sizeof(magic), 1, m_file) != 1 || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        fclose(m_file);
+        m_file = nullptr;
+        return;
+    }
+    fseek(m_file, 0, SEEK_END);
+}
+
+CaptureProvider::~CaptureProvider() {
+    if (m_file) {
+        fclose(m_file);
+    }
+}
+
+void CaptureProvider::flush() {
+    if (m_file) {
+        fflush(m_file);
+    }
+}
+
+void CaptureProvider::setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) {
+    m_read_multiplier = multiplier;
+    m_read_timeout = timeout_ms;
+    m_serial.setReadTimeout(multiplier, timeout_ms);
+}
+
+void CaptureProvider::setWriteTimeout(unsigned int multiplier) {
+    m_serial.setWriteTimeout(multiplier);
+}
+
+bool CaptureProvider::read(uint8_t *buffer, std::size_t count) {
+    // A failed read() does not say how much it consumed, so the bytes are taken
+    // with read_some() and recorded as they come, within the time read() would
+    // have had. A read that times out halfway still leaves its bytes in the file.
+    auto deadline = Clock::now() + milliseconds(m_read_timeout + m_read_multiplier * count);
+    bool result = true;
+    while (count) {
+        auto remaining = std::max<int64_t>(duration_cast<milliseconds>(deadline - Clock::now()).count(), 0);
+        m_serial.setReadTimeout(0, (unsigned int)remaining);
+        std::size_t n = m_serial.read_some(buffer, count);
+        if (n) {
+            record(Direction_Read, buffer, n);
+            buffer += n;
+            count -= n;
+        } else if (remaining == 0 || !m_serial.connected()) {
+            result = false;
+            break;
+        }
+    }
+    m_serial.setReadTimeout(m_read_multiplier, m_read_timeout);
+    return result;
+}
+
+bool CaptureProvider::write(const uint8_t *buffer, std::size_t count) {
+    bool result = m_serial.write(buffer, count);
+    if (result) {
+        record(Direction_Write, buffer, count);
+    }
+    return result;
+}
+
+std::size_t CaptureProvider::read_some(uint8_t *buffer, std::size_t count) {
+    std::size_t n = m_serial.read_some(buffer, count);
+    if (n) {
+        record(Direction_Read, buffer, n);
+    }
+    return n;
+}
+
+std::size_t CaptureProvider::write_some(const uint8_t *buffer, std::size_t count) {
+    std::size_t n = m_serial.write_some(buffer, count);
+    if (n) {
+        record(Direction_Write, buffer, n);
+    }
+    return n;
+}
+
+void CaptureProvider::record(Direction direction, const uint8_t *data, std::size_t count) {
+    if (!m_file) {
+        return;
+    }
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.length = (uint32_t)count;
+    record.direction = direction;
+    record.timestamp_ns = nanoseconds_since_epoch<std::chrono::steady_clock>();
+    fwrite(&record, sizeof(record), 1, m_file);
+    fwrite(data, count, 1, m_file);
+}
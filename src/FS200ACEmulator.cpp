@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstring>
+
+#include "FS200AC/FS200ACEmulator.hpp"
+#include "FS200ACProtocol.hpp"
+
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+
+FS200ACEmulator::Options::Options()
+    : controls(), frame_rate(0), baud(0), boot_banner(true), synthetic(false),
+      ack_timeout(100), min_byte_gap(0) {
+    controls.major_version = 2;
+    controls.minor_version = 1;
+}
+
+FS200ACEmulator::FS200ACEmulator(const Options &options)
+    : m_options(options), m_console(),
+      m_frames_sent(0), m_frames_acked(0) {
+    power_cycle();
+}
+
+void FS200ACEmulator::power_cycle() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = Clock::now();
+    m_state = Idle;
+    m_output.clear();
+    m_line_free = now;
+    m_awaiting_ack = false;
+    m_synthetic_index = 0;
+    m_packet_length = 0;
+    if (m_options.boot_banner) {
+        const uint8_t banner = 'X';
+        queue(&banner, 1, now);
+    }
+}
+
+FS200ACEmulator::State FS200ACEmulator::state() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_state;
+}
+
+FS200AC::ConsoleState FS200ACEmulator::console_state() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_console;
+}
+
+void FS200ACEmulator::push_frame(const Frame &frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frames.push_back(frame);
+}
+
+void FS200ACEmulator::queue(const uint8_t *data, std::size_t count, Clock::time_point now) {
+    // 8N1 puts ten bits on the line per byte
+    nanoseconds byte_time(m_options.baud ? 10000000000ull / m_options.baud : 0);
+    auto ready = std::max(now, m_line_free);
+    for (std::size_t i = 0; i < count; i++) {
+        ready += byte_time;
+        m_output.push_back({data[i], ready});
+    }
+    m_line_free = ready;
+}
+
+void FS200ACEmulator::receive(const uint8_t *data, std::size_t count) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto now = Clock::now();
+    for (std::size_t i = 0; i < count; i++) {
+        handle_byte(data[i], now);
+    }
+}
+
+void FS200ACEmulator::handle_byte(uint8_t b, Clock::time_point now) {
+    if (m_packet_length == 0) {
+        if (b == CODE_ACKNOWLEDGE) {
+            handle_ack(now);
+        } else if (b == 0xa5) {
+            m_packet[m_packet_length++] = b;
+            m_last_byte = now;
+        }
+        return;
+    }
+    // the setup packet is written in one go, only paced command bytes can be lost
+    bool paced = m_packet_length == 1 ? b != 0x19 : m_packet_length == 2 && m_packet[1] != 0x19;
+    // and frames keep being acknowledged in between them. A check byte can be
+    // 0x06 itself (command 0x5c's is), so where one is due and 0x06 is the right
+    // one it completes the command instead. How the console tells the two apart
+    // has not been checked on real hardware.
+    if (paced && b == CODE_ACKNOWLEDGE) {
+        uint8_t command[3];
+        make_command(m_packet[1], command);
+        if (m_packet_length == 1 || command[2] != CODE_ACKNOWLEDGE) {
+            handle_ack(now);
+            return;
+        }
+    }
+    bool too_fast = now - m_last_byte < m_options.min_byte_gap;
+    m_last_byte = now;
+    if (paced && too_fast) {
+        m_packet_length = 0;
+        return;
+    }
+    m_packet[m_packet_length++] = b;
+    if (m_packet_length < 3) {
+        return;
+    }
+    if (m_packet[1] == 0x19) {
+        // setup packet, the header is followed by 32 bytes
+        if (m_packet_length < sizeof(m_packet)) {
+            return;
+        }
+        m_packet_length = 0;
+        FS200AC::ConsoleState console;
+        if (m_state >= RequestingSetup && parse_setup_packet(m_packet + 2, console)) {
+            m_console = console;
+            queue(&CODE_ACKNOWLEDGE, 1, now);
+            if (m_state != Streaming) {
+                m_state = Streaming;
+                m_awaiting_ack = false;
+                m_next_frame = now;
+            }
+        }
+        return;
+    }
+    m_packet_length = 0;
+    uint8_t command[3];
+    make_command(m_packet[1], command);
+    if (command[2] == m_packet[2]) {
+        handle_command(m_packet[1], now);
+    }
+}
+
+void FS200ACEmulator::handle_command(uint8_t command, Clock::time_point now) {
+    queue(&CODE_ACKNOWLEDGE, 1, now);
+    switch (command) {
+        case COMMAND_RESET: {
+            const uint8_t banner = 'X';
+            queue(&banner, 1, now);
+            m_state = Idle;
+            m_awaiting_ack = false;
+            break;
+        }
+        case 0x23: {
+            uint8_t block[24];
+            make_controls_block(m_options.controls, 0x23, block);
+            queue(block, sizeof(block), now);
+            m_state = SendingControls;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void FS200ACEmulator::handle_ack(Clock::time_point now) {
+    switch (m_state) {
+        case SendingControls: {
+            const uint8_t request[] = {0xa5, 0x23, 0x5c};
+            queue(request, sizeof(request), now);
+            m_state = RequestingSetup;
+            break;
+        }
+        case RequestingSetup:
+            m_state = AwaitingSetup;
+            break;
+        case Streaming:
+            if (m_awaiting_ack) {
+                m_awaiting_ack = false;
+                m_frames_acked.fetch_add(1, std::memory_order_relaxed);
+                auto period = m_options.frame_rate > 0 ?
+                    nanoseconds((long long)(1e9 / m_options.frame_rate)) : nanoseconds(0);
+                m_next_frame = std::max(now, m_frame_sent + period);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+FS200ACEmulator::Frame FS200ACEmulator::next_frame() {
+    if (!m_frames.empty()) {
+        Frame frame = m_frames.front();
+        m_frames.pop_front();
+        return frame;
+    }
+    Frame frame = {};
+    if (!m_options.synthetic) {
+        return frame;
+    }
+    // walk the protocol table so every known input gets exercised
+    const std::size_t count = sizeof(PROTOCOL) / sizeof(PROTOCOL[0]);
+    uint64_t i = m_synthetic_index++;
+    const ProtocolEntry &entry = PROTOCOL[i % count];
+    frame.roll = (int8_t)((i * 3) % 255 - 127);
+    frame.pitch = (int8_t)((i * 5) % 255 - 127);
+    frame.yaw = (int8_t)((i * 7) % 255 - 127);
+    frame.id = entry.id;
+    uint8_t value = (uint8_t)((i / count) & 0x7f);
+    switch (entry.payload) {
+        case Payload_Trim:
+            frame.data[0] = 1 + entry.control - EVENT_DECODERS[entry.id].control;
+            break;
+        case Payload_Toggle:
+            frame.data[0] = value & 1;
+            break;
+        case Payload_Byte:
+            if (entry.control == FS200AC::GEAR) {
+                frame.data[0] = value & 1;
+            } else if (entry.control == FS200AC::FLAPS) {
+                frame.data[0] = value % 3;
+            } else if (entry.control == FS200AC::FREQ_SELECT_RADIO) {
+                frame.data[0] = 1 + value % 5;
+            } else {
+                frame.data[0] = value;
+            }
+            break;
+        default:
+            frame.data[0] = value;
+            frame.data[1] = (uint8_t)((i >> 7) & 3);
+            break;
+    }
+    return frame;
+}
+
+void FS200ACEmulator::stream(Clock::time_point now) {
+    if (m_state != Streaming) {
+        return;
+    }
+    if (m_awaiting_ack ? now < m_frame_sent + m_options.ack_timeout : now < m_next_frame) {
+        return;
+    }
+    // an unacknowledged frame goes out again as it was, only an ACK moves on to the next
+    if (!m_awaiting_ack) {
+        Frame frame = next_frame();
+        encode_frame(frame.roll, frame.pitch, frame.yaw, frame.id, frame.data[0], frame.data[1], m_pending_frame);
+        m_frames_sent.fetch_add(1, std::memory_order_relaxed);
+    }
+    queue(m_pending_frame, sizeof(m_pending_frame), now);
+    m_frame_sent = now;
+    m_awaiting_ack = true;
+}
+
+std::size_t FS200ACEmulator::transmit(uint8_t *buffer, std::size_t count, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stream(now);
+    std::size_t n = 0;
+    while (n < count && !m_output.empty() && m_output.front().ready <= now) {
+        buffer[n++] = m_output.front().byte;
+        m_output.pop_front();
+    }
+    return n;
+}
+
+FS200ACEmulator::Clock::time_point FS200ACEmulator::next_output(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stream(now);
+    if (!m_output.empty()) {
+        return m_output.front().ready;
+    }
+    if (m_state == Streaming) {
+        return m_awaiting_ack ? m_frame_sent + m_options.ack_timeout : m_next_frame;
+    }
+    return Clock::time_point::max();
+}
+
+FS200ACEmulator::Provider::Provider(FS200ACEmulator &emulator)
+    : m_emulator(emulator), m_read_multiplier(0), m_read_constant(0) {
+}
+
+void FS200ACEmulator::Provider::setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) {
+    m_read_multiplier = multiplier;
+    m_read_constant = timeout_ms;
+}
+
+void FS200ACEmulator::Provider::setWriteTimeout(unsigned int) {
+}
+
+bool FS200ACEmulator::Provider::read(uint8_t *buffer, std::size_t count) {
+    auto now = Clock::now();
+    auto deadline = now + milliseconds(m_read_constant + m_read_multiplier * count);
+    for (;;) {
+        std::size_t n = m_emulator.transmit(buffer, count, now);
+        buffer += n;
+        count -= n;
+        if (!count) {
+            return true;
+        }
+        auto next = m_emulator.next_output(now);
+        if (next > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_until(next);
+        now = Clock::now();
+    }
+}
+
+std::size_t FS200ACEmulator::Provider::read_some(uint8_t *buffer, std::size_t count) {
+    auto now = Clock::now();
+    auto deadline = now + milliseconds(m_read_constant + m_read_multiplier);
+    for (;;) {
+        std::size_t n = m_emulator.transmit(buffer, count, now);
+        if (n) {
+            return n;
+        }
+        auto next = m_emulator.next_output(now);
+        if (next > deadline) {
+            return 0;
+        }
+        std::this_thread::sleep_until(next);
+        now = Clock::now();
+    }
+}
+
+bool FS200ACEmulator::Provider::write(const uint8_t *buffer, std::size_t count) {
+    m_emulator.receive(buffer, count);
+    return true;
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "FS200AC/FS200ACEmulator.hpp"
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+
+FS200ACEmulator::PtyServer::PtyServer(FS200ACEmulator &emulator)
+    : m_emulator(emulator), m_master(-1), m_slave(-1), m_running(false) {
+}
+
+FS200ACEmulator::PtyServer::~PtyServer() {
+    stop();
+}
+
+bool FS200ACEmulator::PtyServer::start() {
+    if (m_running.load()) {
+        return false;
+    }
+    m_master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (m_master < 0) {
+        return false;
+    }
+    char name[64];
+    if (grantpt(m_master) != 0 || unlockpt(m_master) != 0 ||
+        ptsname_r(m_master, name, sizeof(name)) != 0) {
+        close(m_master);
+        m_master = -1;
+        return false;
+    }
+    m_slave_name = name;
+    // holding the slave open keeps the master from reporting EIO between host
+    // opens, and lets us put the line into raw mode before anyone uses it
+    m_slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    termios tio;
+    if (m_slave >= 0 && tcgetattr(m_slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(m_slave, TCSANOW, &tio);
+    }
+    m_running.store(true);
+    m_thread = std::thread(&PtyServer::run, this);
+    return true;
+}
+
+void FS200ACEmulator::PtyServer::stop() {
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_slave >= 0) {
+        close(m_slave);
+        m_slave = -1;
+    }
+    if (m_master >= 0) {
+        close(m_master);
+        m_master = -1;
+    }
+}
+
+void FS200ACEmulator::PtyServer::run() {
+    uint8_t buffer[256];
+    // output the pty has not taken yet, written before anything more is taken from the emulator
+    uint8_t pending[256];
+    std::size_t pending_pos = 0;
+    std::size_t pending_end = 0;
+    while (m_running.load(std::memory_order_relaxed)) {
+        // wake up periodically to notice stop()
+        int timeout = 10;
+        if (pending_pos == pending_end) {
+            auto now = Clock::now();
+            auto next = m_emulator.next_output(now);
+            if (next <= now) {
+                timeout = 0;
+            } else if (next < now + milliseconds(timeout)) {
+                timeout = (int)duration_cast<milliseconds>(next - now).count() + 1;
+            }
+        }
+        pollfd pfd = {m_master, (short)(pending_pos == pending_end ? POLLIN : POLLIN | POLLOUT), 0};
+        if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+            ssize_t n = ::read(m_master, buffer, sizeof(buffer));
+            if (n > 0) {
+                m_emulator.receive(buffer, n);
+            }
+        }
+        if (pending_pos == pending_end) {
+            pending_pos = 0;
+            pending_end = m_emulator.transmit(pending, sizeof(pending), Clock::now());
+        }
+        while (pending_pos != pending_end) {
+            ssize_t n = ::write(m_master, pending + pending_pos, pending_end - pending_pos);
+            if (n > 0) {
+                pending_pos += n;
+                continue;
+            }
+            // a full pty is written once it drains; anything else would not go away
+            if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                pending_pos = pending_end;
+            }
+            break;
+        }
+    }
+}
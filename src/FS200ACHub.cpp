@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cassert>
+
+#include "FS200AC/FS200ACHub.hpp"
+
+FS200ACHub::FS200ACHub(std::size_t queue_capacity)
+    : m_samples(queue_capacity), m_dropped(0), m_stopping(false) {
+}
+
+FS200ACHub::~FS200ACHub() {
+    stop();
+}
+
+std::size_t FS200ACHub::add_console(FS200AC::SerialProvider &provider, const FS200AC::ConsoleState *initial_state) {
+    assert(!m_thread.joinable());
+    std::unique_ptr<Console> console(new Console(provider));
+    // failures show up as the Failed status rather than asserting
+    console->fs.set_resilient(true);
+    console->use_default_state = initial_state == nullptr;
+    if (initial_state) {
+        console->initial_state = *initial_state;
+    }
+    m_consoles.push_back(std::move(console));
+    return m_consoles.size() - 1;
+}
+
+bool FS200ACHub::start() {
+    if (m_thread.joinable() || m_consoles.empty()) {
+        return false;
+    }
+    m_stopping.store(false);
+    for (auto &console : m_consoles) {
+        console->status.store(Initializing);
+    }
+    m_thread = std::thread(&FS200ACHub::run, this);
+    return true;
+}
+
+void FS200ACHub::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopping.store(true);
+    m_thread.join();
+}
+
+void FS200ACHub::run() {
+    std::vector<Task<bool>> tasks;
+    tasks.reserve(m_consoles.size());
+    for (std::size_t i = 0; i < m_consoles.size(); i++) {
+        tasks.push_back(run_console(i));
+        tasks.back().start();
+    }
+    // every task ends on its own once m_stopping is set
+    while (!std::all_of(tasks.begin(), tasks.end(), [](const Task<bool> &task) { return task.done(); })) {
+        m_reactor.run_once(std::chrono::milliseconds(100));
+    }
+}
+
+Task<bool> FS200ACHub::run_console(std::size_t index) {
+    Console &console = *m_consoles[index];
+    bool initialized;
+    if (console.use_default_state) {
+        initialized = co_await console.fs.initialize_async(m_reactor, console.controls);
+    } else {
+        initialized = co_await console.fs.initialize_async(m_reactor, console.controls, console.initial_state);
+    }
+    if (!initialized) {
+        console.status.store(Failed);
+        co_return false;
+    }
+    console.status.store(Streaming, std::memory_order_release);
+    TaggedSample tagged;
+    tagged.console = index;
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (co_await console.fs.poll_async(m_reactor, tagged.sample)) {
+            if (!m_samples.push(tagged)) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    bool reset = co_await console.fs.shutdown_async(m_reactor);
+    console.status.store(Stopped);
+    co_return reset;
+}
+
+bool FS200ACHub::pop(TaggedSample &sample) {
+    return m_samples.pop(sample);
+}
+
+std::size_t FS200ACHub::pop(TaggedSample *samples, std::size_t count) {
+    return m_samples.pop(samples, count);
+}
+
+FS200ACHub::Status FS200ACHub::status(std::size_t console) const {
+    return m_consoles[console]->status.load(std::memory_order_acquire);
+}
+
+const FS200AC::ControlsState &FS200ACHub::controls(std::size_t console) const {
+    return m_consoles[console]->controls;
+}
+
+FS200AC &FS200ACHub::console(std::size_t console) {
+    return m_consoles[console]->fs;
+}
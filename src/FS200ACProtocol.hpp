@@ -0,0 +1,410 @@
+#ifndef FS200AC_PROTOCOL_HPP
+#define FS200AC_PROTOCOL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include "FS200AC/FS200AC.hpp"
+
+// wire format helpers shared by the blocking and async protocol code
+
+typedef std::chrono::steady_clock Clock;
+
+const uint8_t COMMAND_RESET = 0x16;
+const uint8_t CODE_ACKNOWLEDGE = FS200AC::CODE_ACKNOWLEDGE;
+const uint8_t CODE_BANNER = FS200AC::CODE_BANNER;
+
+// write timeout the protocol code gives the port, in ms per byte
+const unsigned int WRITE_TIMEOUT_PER_BYTE = 42;
+// gap the console was observed to need between command bytes, in ms
+const unsigned int COMMAND_BYTE_GAP = 42;
+// where adaptive pacing starts probing, roughly back to back at 9600 baud
+const unsigned int COMMAND_PROBE_GAP = 2;
+
+// How a measured timeout is derived: the fixed value the protocol code always
+// used serves until there are samples measurements, then it is twice their
+// 99th percentile plus margin, kept within [floor, ceiling].
+struct TimeoutRule {
+    std::chrono::milliseconds fallback;
+    std::chrono::milliseconds floor;
+    std::chrono::milliseconds ceiling;
+    std::chrono::milliseconds margin;
+    uint64_t samples;
+};
+const TimeoutRule FRAME_TIMEOUT = {std::chrono::milliseconds(100), std::chrono::milliseconds(20), std::chrono::milliseconds(400), std::chrono::milliseconds(10), 64};
+const TimeoutRule COMMAND_TIMEOUT = {std::chrono::milliseconds(500), std::chrono::milliseconds(50), std::chrono::milliseconds(2000), std::chrono::milliseconds(20), 4};
+// a banner that is already on its way takes about as long as a command acknowledgement
+const TimeoutRule BANNER_TIMEOUT = {std::chrono::milliseconds(50), std::chrono::milliseconds(10), std::chrono::milliseconds(50), std::chrono::milliseconds(5), 4};
+const TimeoutRule RESPONSE_TIMEOUT = {std::chrono::milliseconds(440), std::chrono::milliseconds(50), std::chrono::milliseconds(1760), std::chrono::milliseconds(20), 4};
+const TimeoutRule RESET_TIMEOUT = {std::chrono::milliseconds(500), std::chrono::milliseconds(100), std::chrono::milliseconds(2000), std::chrono::milliseconds(50), 2};
+
+enum EventID {
+    ID_NONE = 0,
+
+    // knobs
+    // uint16_t
+    ID_NAV1_COURSE_SELECTOR = 0x02,
+    ID_NAV2_OBS = 0x04,
+    ID_ADF_BRG = 0x06,
+    ID_BARO = 0x08,
+    ID_AUTOPILOT_HEADING = 0x0a,
+    ID_FREQ_TUNE = 0x0c,
+    // 2x uint8_t
+    ID_FREQ_TUNE_XPNDR = 0x0e, // special handling
+
+    // momentary buttons
+    // no state
+    ID_NAV1_USE_STBY = 0x10,
+    ID_NAV2_USE_STBY = 0x12,
+    ID_ADF_USE_STBY = 0x14,
+    ID_TIMER = 0x42,
+    ID_RMI = 0x44,
+    ID_TRIM = 0x3e, // 2x
+    ID_AUTOPILOT_TRIM = 0x40, // 2x
+    ID_YOKE_SWITCH_DOWN = 0x46,
+    ID_YOKE_SWITCH_UP = 0x48,
+
+    // toggle buttons
+    // 1-bit state
+    ID_NAV1_ON = 0x18,
+    ID_NAV1_ID = 0x1a,
+    ID_NAV1_RAD = 0x1c,
+    ID_NAV2_ON = 0x1e,
+    ID_NAV2_ID = 0x20,
+    ID_NAV2_RAD = 0x22,
+    ID_ADF_ON = 0x24,
+    ID_ADF_ID = 0x26,
+    ID_DME_ON = 0x28,
+    ID_DME_NAV = 0x2a,
+    ID_AUTOPILOT_ON = 0x2c,
+    ID_AUTOPILOT_HDG = 0x2e,
+    ID_AUTOPILOT_ALT = 0x30,
+    ID_FUEL = 0x36,
+
+    // switches
+    // uint8_t
+    ID_GEAR = 0x32,
+    ID_FLAPS = 0x34,
+    ID_FREQ_SELECT_RADIO = 0x16,
+
+    // sliders
+    // uint8_t
+    ID_THROTTLE = 0x38,
+    ID_PROP_RPM = 0x3a,
+    ID_MIXTURE = 0x3c,
+    ID_COWL_FLAP = 0x4a,
+    ID_CARB_HEAT = 0x4c,
+};
+
+inline void make_command(uint8_t command, uint8_t bytes[3]) {
+    bytes[0] = 0xa5;
+    bytes[1] = command;
+    bytes[2] = (uint8_t)(~(command ^ 0xa5) & 0x7f);
+}
+
+inline void make_setup_packet(const FS200AC::ConsoleState &state, uint8_t buffer[32]) {
+    const uint8_t packet[32] = {
+        state.nav1_standby_freq.second, state.nav1_standby_freq.first,
+        state.nav1_current_freq.second, state.nav1_current_freq.first,
+
+        state.nav2_standby_freq.second, state.nav2_standby_freq.first,
+        state.nav2_current_freq.second, state.nav2_current_freq.first,
+
+        state.adf_standby_freq.second, state.adf_standby_freq.first,
+        state.adf_current_freq.second, state.adf_current_freq.first,
+        state.current_radio,
+
+        (uint8_t)(state.nav1_course_selector & 0x7f),
+        (uint8_t)(state.nav1_course_selector >> 7),
+
+        (uint8_t)(state.nav2_obs & 0x7f),
+        (uint8_t)(state.nav2_obs >> 7),
+
+        (uint8_t)(state.adf_brg & 0x7f),
+        (uint8_t)(state.adf_brg >> 7),
+
+        (uint8_t)(state.baro & 0x7f),
+        (uint8_t)(state.baro >> 7),
+
+        (uint8_t)(state.autopilot_hdg & 0x7f),
+        (uint8_t)(state.autopilot_hdg >> 7),
+
+        state.unknown_freq.second, state.unknown_freq.first,
+
+        state.com_freq.second, state.com_freq.first,
+
+        state.unknown[0], state.unknown[1], state.unknown[2], state.unknown[3],
+        0xbc
+    };
+    for (int i = 0; i < 32; i++) {
+        buffer[i] = packet[i];
+    }
+    for (int i = 0; i < 31; i++) {
+        buffer[31] ^= buffer[i];
+    }
+    buffer[31] = ~buffer[31] & 0x7f;
+}
+
+// ck is the byte following the 0xa5 that starts the block
+inline bool check_controls_state(uint8_t ck, FS200AC::ControlsState &controls, uint8_t checkbyte) {
+    static_assert(sizeof(FS200AC::ControlsState) == 21);
+    for (std::size_t i = 0; i < sizeof(controls); i++) {
+        ck ^= ((uint8_t*)&controls)[i];
+    }
+    controls.major_version -= 48;
+    controls.minor_version -= 48;
+    return (ck ^ checkbyte) == 0x7f;
+}
+
+
+// How the two payload bytes of a frame turn into an Event value
+enum Payload : uint8_t {
+    Payload_None,
+    // 14-bit value, low 7 bits first
+    Payload_Knob,
+    // transponder digits, low 2 bits of the first byte are the high bits
+    Payload_Xpndr,
+    // momentary switch, the first byte selects down (1) or up (2)
+    Payload_Trim,
+    Payload_Toggle,
+    Payload_Byte,
+};
+
+// Where an event lands in FS200AC::LiveState
+enum LiveFieldKind : uint8_t {
+    LiveField_None,
+    LiveField_Byte,
+    LiveField_Word,
+    // the standby frequency of the selected radio
+    LiveField_Frequency,
+    // exchanges a standby frequency with the active one that follows it
+    LiveField_Swap,
+};
+
+struct LiveField {
+    LiveFieldKind kind;
+    uint16_t offset;
+};
+
+struct ProtocolEntry {
+    uint8_t id;
+    FS200AC::EventType type;
+    Payload payload;
+    FS200AC::Control control;
+    const char *name;
+    LiveField live;
+};
+
+#define FIELD(kind, member) LiveField{LiveField_##kind, (uint16_t)offsetof(FS200AC::LiveState, member)}
+#define NO_FIELD LiveField{LiveField_None, 0}
+
+// The single description of every input the console reports. The trim IDs
+// carry their direction in the payload, so they are listed once per control.
+constexpr ProtocolEntry PROTOCOL[] = {
+    {ID_NONE, FS200AC::None, Payload_None, FS200AC::NONE, "NONE", NO_FIELD},
+
+    {ID_NAV1_COURSE_SELECTOR, FS200AC::Knob, Payload_Knob, FS200AC::NAV1_COURSE_SELECTOR, "NAV1_COURSE_SELECTOR", FIELD(Word, console.nav1_course_selector)},
+    {ID_NAV2_OBS, FS200AC::Knob, Payload_Knob, FS200AC::NAV2_OBS, "NAV2_OBS", FIELD(Word, console.nav2_obs)},
+    {ID_ADF_BRG, FS200AC::Knob, Payload_Knob, FS200AC::ADF_BRG, "ADF_BRG", FIELD(Word, console.adf_brg)},
+    {ID_BARO, FS200AC::Knob, Payload_Knob, FS200AC::BARO, "BARO", FIELD(Word, console.baro)},
+    {ID_AUTOPILOT_HEADING, FS200AC::Knob, Payload_Knob, FS200AC::AUTOPILOT_HEADING, "AUTOPILOT_HEADING", FIELD(Word, console.autopilot_hdg)},
+    {ID_FREQ_TUNE, FS200AC::Knob, Payload_Knob, FS200AC::FREQ_TUNE_RADIO, "FREQ_TUNE_RADIO", FIELD(Frequency, console)},
+    {ID_FREQ_TUNE_XPNDR, FS200AC::Knob, Payload_Xpndr, FS200AC::FREQ_TUNE_RADIO, "FREQ_TUNE_RADIO", FIELD(Frequency, console)},
+
+    {ID_NAV1_USE_STBY, FS200AC::Button, Payload_None, FS200AC::NAV1_USE_STBY, "NAV1_USE_STBY", FIELD(Swap, console.nav1_standby_freq)},
+    {ID_NAV2_USE_STBY, FS200AC::Button, Payload_None, FS200AC::NAV2_USE_STBY, "NAV2_USE_STBY", FIELD(Swap, console.nav2_standby_freq)},
+    {ID_ADF_USE_STBY, FS200AC::Button, Payload_None, FS200AC::ADF_USE_STBY, "ADF_USE_STBY", FIELD(Swap, console.adf_standby_freq)},
+    {ID_TIMER, FS200AC::Button, Payload_None, FS200AC::TIMER, "TIMER", NO_FIELD},
+    {ID_RMI, FS200AC::Button, Payload_None, FS200AC::RMI, "RMI", NO_FIELD},
+    {ID_YOKE_SWITCH_DOWN, FS200AC::Button, Payload_None, FS200AC::YOKE_BUTTON_DOWN, "YOKE_BUTTON_DOWN", NO_FIELD},
+    {ID_YOKE_SWITCH_UP, FS200AC::Button, Payload_None, FS200AC::YOKE_BUTTON_UP, "YOKE_BUTTON_UP", NO_FIELD},
+    {ID_TRIM, FS200AC::Button, Payload_Trim, FS200AC::TRIM_DN, "TRIM_DN", NO_FIELD},
+    {ID_TRIM, FS200AC::Button, Payload_Trim, FS200AC::TRIM_UP, "TRIM_UP", NO_FIELD},
+    {ID_AUTOPILOT_TRIM, FS200AC::Button, Payload_Trim, FS200AC::AUTOPILOT_TRIM_DN, "AUTOPILOT_TRIM_DN", NO_FIELD},
+    {ID_AUTOPILOT_TRIM, FS200AC::Button, Payload_Trim, FS200AC::AUTOPILOT_TRIM_UP, "AUTOPILOT_TRIM_UP", NO_FIELD},
+
+    {ID_NAV1_ON, FS200AC::Toggle, Payload_Toggle, FS200AC::NAV1_ON, "NAV1_ON", FIELD(Byte, controls.nav1_on)},
+    {ID_NAV1_ID, FS200AC::Toggle, Payload_Toggle, FS200AC::NAV1_ID, "NAV1_ID", FIELD(Byte, controls.nav1_id)},
+    {ID_NAV1_RAD, FS200AC::Toggle, Payload_Toggle, FS200AC::NAV1_RAD, "NAV1_RAD", FIELD(Byte, controls.nav1_rad)},
+    {ID_NAV2_ON, FS200AC::Toggle, Payload_Toggle, FS200AC::NAV2_ON, "NAV2_ON", FIELD(Byte, controls.nav2_on)},
+    {ID_NAV2_ID, FS200AC::Toggle, Payload_Toggle, FS200AC::NAV2_ID, "NAV2_ID", FIELD(Byte, controls.nav2_id)},
+    {ID_NAV2_RAD, FS200AC::Toggle, Payload_Toggle, FS200AC::NAV2_RAD, "NAV2_RAD", FIELD(Byte, controls.nav2_rad)},
+    {ID_ADF_ON, FS200AC::Toggle, Payload_Toggle, FS200AC::ADF_ON, "ADF_ON", FIELD(Byte, controls.adf_on)},
+    {ID_ADF_ID, FS200AC::Toggle, Payload_Toggle, FS200AC::ADF_ID, "ADF_ID", FIELD(Byte, controls.adf_id)},
+    {ID_DME_ON, FS200AC::Toggle, Payload_Toggle, FS200AC::DME_ON, "DME_ON", FIELD(Byte, controls.dme_on)},
+    {ID_DME_NAV, FS200AC::Toggle, Payload_Toggle, FS200AC::DME_NAV, "DME_NAV", FIELD(Byte, controls.dme_nav)},
+    {ID_AUTOPILOT_ON, FS200AC::Toggle, Payload_Toggle, FS200AC::AUTOPILOT_ON, "AUTOPILOT_ON", FIELD(Byte, controls.autopilot_on)},
+    {ID_AUTOPILOT_HDG, FS200AC::Toggle, Payload_Toggle, FS200AC::AUTOPILOT_HDG, "AUTOPILOT_HDG", FIELD(Byte, controls.autopilot_hdg)},
+    {ID_AUTOPILOT_ALT, FS200AC::Toggle, Payload_Toggle, FS200AC::AUTOPILOT_ALT, "AUTOPILOT_ALT", FIELD(Byte, controls.autopilot_alt)},
+    {ID_FUEL, FS200AC::Toggle, Payload_Toggle, FS200AC::FUEL, "FUEL", FIELD(Byte, controls.fuel)},
+
+    // the radio selector is logically treated as a switch
+    {ID_FREQ_SELECT_RADIO, FS200AC::Switch, Payload_Byte, FS200AC::FREQ_SELECT_RADIO, "FREQ_SELECT_RADIO", FIELD(Byte, console.current_radio)},
+    {ID_GEAR, FS200AC::Switch, Payload_Byte, FS200AC::GEAR, "GEAR", FIELD(Byte, controls.landing_gear)},
+    {ID_FLAPS, FS200AC::Switch, Payload_Byte, FS200AC::FLAPS, "FLAPS", FIELD(Byte, controls.flaps)},
+
+    {ID_THROTTLE, FS200AC::Slider, Payload_Byte, FS200AC::THROTTLE, "THROTTLE", FIELD(Byte, controls.throttle)},
+    {ID_PROP_RPM, FS200AC::Slider, Payload_Byte, FS200AC::PROP_RPM, "PROP_RPM", FIELD(Byte, controls.prop_rpm)},
+    {ID_MIXTURE, FS200AC::Slider, Payload_Byte, FS200AC::MIXTURE, "MIXTURE", FIELD(Byte, controls.fuel_mixture)},
+    {ID_COWL_FLAP, FS200AC::Slider, Payload_Byte, FS200AC::COWL_FLAP, "COWL_FLAP", FIELD(Byte, cowl_flap)},
+    {ID_CARB_HEAT, FS200AC::Slider, Payload_Byte, FS200AC::CARB_HEAT, "CARB_HEAT", FIELD(Byte, carb_heat)},
+};
+
+#undef FIELD
+#undef NO_FIELD
+
+// Everything fill_event() needs for one ID byte, so decoding is a single
+// indexed load plus arithmetic: value = (b2 & b2_mask) << b2_shift | (b3 & b3_mask) << b3_shift
+struct EventDecoder {
+    bool known;
+    bool wide;
+    bool boolean;
+    FS200AC::EventType type;
+    uint8_t control;
+    // added to control from the first payload byte - 1
+    uint8_t control_mask;
+    uint8_t b2_mask, b2_shift;
+    uint8_t b3_mask, b3_shift;
+};
+
+constexpr std::array<EventDecoder, 128> make_event_decoders() {
+    std::array<EventDecoder, 128> decoders{};
+    for (int id = 0; id < 128; id++) {
+        // unknown IDs decode to no event, on a control of their own rather than
+        // the raw ID, which would alias the trim controls
+        decoders[id] = {false, false, false, FS200AC::None, FS200AC::UNKNOWN, 0, 0, 0, 0, 0};
+    }
+    for (const ProtocolEntry &entry : PROTOCOL) {
+        EventDecoder &d = decoders[entry.id];
+        if (d.known) {
+            continue;
+        }
+        d.known = true;
+        d.type = entry.type;
+        d.control = entry.control;
+        switch (entry.payload) {
+            case Payload_None:
+                break;
+            case Payload_Knob:
+                d.wide = true;
+                d.b2_mask = 0xff;
+                d.b3_mask = 0xff;
+                d.b3_shift = 7;
+                break;
+            case Payload_Xpndr:
+                d.wide = true;
+                d.b2_mask = 3;
+                d.b2_shift = 8;
+                d.b3_mask = 0xff;
+                break;
+            case Payload_Trim:
+                d.control_mask = 1;
+                break;
+            case Payload_Toggle:
+                d.boolean = true;
+                d.b2_mask = 0xff;
+                break;
+            case Payload_Byte:
+                d.b2_mask = 0xff;
+                break;
+        }
+    }
+    return decoders;
+}
+
+constexpr std::array<EventDecoder, 128> EVENT_DECODERS = make_event_decoders();
+
+constexpr std::array<const char*, 128> make_control_names() {
+    std::array<const char*, 128> names{};
+    for (const ProtocolEntry &entry : PROTOCOL) {
+        names[entry.control] = entry.name;
+    }
+    names[FS200AC::UNKNOWN] = "UNKNOWN";
+    return names;
+}
+
+constexpr std::array<const char*, 128> CONTROL_NAMES = make_control_names();
+
+constexpr std::array<LiveField, 128> make_live_fields() {
+    std::array<LiveField, 128> fields{};
+    for (const ProtocolEntry &entry : PROTOCOL) {
+        fields[entry.control] = entry.live;
+    }
+    return fields;
+}
+
+// indexed by Control
+constexpr std::array<LiveField, 128> LIVE_FIELDS = make_live_fields();
+
+static_assert(EVENT_DECODERS[ID_TRIM].control == FS200AC::TRIM_DN);
+static_assert(EVENT_DECODERS[ID_FREQ_TUNE_XPNDR].control == FS200AC::FREQ_TUNE_RADIO);
+static_assert(!EVENT_DECODERS[0x7f].known);
+static_assert(EVENT_DECODERS[FS200AC::TRIM_DN].control == FS200AC::UNKNOWN);
+
+// console side of the protocol, used by the emulator
+
+inline void encode_frame(int8_t roll, int8_t pitch, int8_t yaw, uint8_t id, uint8_t b2, uint8_t b3, uint8_t frame[9]) {
+    auto magnitude = [](int8_t v) { return (uint8_t)(v < 0 ? (v == -128 ? 127 : -v) : v); };
+    frame[0] = 0xa5;
+    frame[1] = (uint8_t)((pitch < 0 ? 1 : 0) | (roll < 0 ? 2 : 0) | (yaw < 0 ? 4 : 0));
+    frame[2] = magnitude(pitch);
+    frame[3] = magnitude(roll);
+    frame[4] = magnitude(yaw);
+    frame[5] = id & 0x7f;
+    frame[6] = b2 & 0x7f;
+    frame[7] = b3 & 0x7f;
+    frame[8] = 0x7f;
+    for (int i = 1; i < 8; i++) {
+        frame[8] ^= frame[i];
+    }
+}
+
+inline void make_controls_block(const FS200AC::ControlsState &controls, uint8_t seed, uint8_t block[24]) {
+    block[0] = 0xa5;
+    block[1] = seed;
+    const uint8_t *raw = (const uint8_t*)&controls;
+    uint8_t ck = seed;
+    for (int i = 0; i < (int)sizeof(controls); i++) {
+        block[2 + i] = raw[i];
+    }
+    block[2 + offsetof(FS200AC::ControlsState, major_version)] += 48;
+    block[2 + offsetof(FS200AC::ControlsState, minor_version)] += 48;
+    for (int i = 0; i < (int)sizeof(controls); i++) {
+        ck ^= block[2 + i];
+    }
+    block[23] = ck ^ 0x7f;
+}
+
+inline bool parse_setup_packet(const uint8_t buffer[32], FS200AC::ConsoleState &state) {
+    uint8_t ck = 0xbc;
+    for (int i = 0; i < 31; i++) {
+        ck ^= buffer[i];
+    }
+    if ((uint8_t)(~ck & 0x7f) != buffer[31]) {
+        return false;
+    }
+    auto freq = [&](int i) { return FS200AC::ConsoleState::RadioFrequency(buffer[i + 1], buffer[i]); };
+    auto word = [&](int i) { return (uint16_t)(buffer[i] | (buffer[i + 1] << 7)); };
+    state.nav1_standby_freq = freq(0);
+    state.nav1_current_freq = freq(2);
+    state.nav2_standby_freq = freq(4);
+    state.nav2_current_freq = freq(6);
+    state.adf_standby_freq = freq(8);
+    state.adf_current_freq = freq(10);
+    state.current_radio = buffer[12];
+    state.nav1_course_selector = word(13);
+    state.nav2_obs = word(15);
+    state.adf_brg = word(17);
+    state.baro = word(19);
+    state.autopilot_hdg = word(21);
+    state.unknown_freq = freq(23);
+    state.com_freq = freq(25);
+    for (int i = 0; i < 4; i++) {
+        state.unknown[i] = buffer[27 + i];
+    }
+    return true;
+}
+
+#endif
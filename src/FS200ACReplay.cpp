@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FS200AC/FS200ACCapture.hpp"
+
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+typedef std::chrono::steady_clock Clock;
+
+ReplayProvider::ReplayProvider(const char *path, Mode mode)
+    : m_mode(mode), m_begin(nullptr), m_end(nullptr), m_records(nullptr), m_pos(nullptr), m_record_pos(nullptr), m_record_end(nullptr),
+      m_size(0), m_read_multiplier(0), m_read_timeout(0), m_started(false), m_first_timestamp(0) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (std::size_t)st.st_size > sizeof(CaptureProvider::MAGIC)) {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            std::size_t header = 0;
+            if (memcmp(map, CaptureProvider::MAGIC, sizeof(CaptureProvider::MAGIC)) == 0) {
+                header = sizeof(CaptureProvider::MAGIC) + sizeof(CaptureProvider::Header);
+            } else if (memcmp(map, CaptureProvider::MAGIC_V1, sizeof(CaptureProvider::MAGIC_V1)) == 0) {
+                header = sizeof(CaptureProvider::MAGIC_V1);
+            }
+            if (header && (std::size_t)st.st_size >= header) {
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+                m_begin = (const uint8_t*)map;
+                m_end = m_begin + st.st_size;
+                m_records = m_begin + header;
+                m_size = st.st_size;
+                if (header > sizeof(CaptureProvider::MAGIC)) {
+                    CaptureProvider::Header anchor;
+                    memcpy(&anchor, m_begin + sizeof(CaptureProvider::MAGIC), sizeof(anchor));
+                    m_captured_at = std::chrono::system_clock::time_point(
+                        std::chrono::duration_cast<std::chrono::system_clock::duration>(nanoseconds(anchor.system_ns)));
+                }
+            } else {
+                munmap(map, st.st_size);
+            }
+        }
+    }
+    close(fd);
+    rewind();
+}
+
+ReplayProvider::~ReplayProvider() {
+    if (m_begin) {
+        munmap((void*)m_begin, m_size);
+    }
+}
+
+void ReplayProvider::rewind() {
+    m_pos = m_records;
+    m_record_pos = m_record_end = nullptr;
+    m_started = false;
+    skip_writes();
+}
+
+void ReplayProvider::setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) {
+    m_read_multiplier = multiplier;
+    m_read_timeout = timeout_ms;
+}
+
+void ReplayProvider::setWriteTimeout(unsigned int) {
+}
+
+bool ReplayProvider::write(const uint8_t *, std::size_t) {
+    return is_open();
+}
+
+void ReplayProvider::skip_writes() {
+    CaptureProvider::Record record;
+    while (m_pos && m_end - m_pos >= (std::ptrdiff_t)sizeof(record)) {
+        memcpy(&record, m_pos, sizeof(record));
+        const uint8_t *data = m_pos + sizeof(record);
+        if ((std::size_t)(m_end - data) < record.length) {
+            // truncated by a crash while capturing
+            break;
+        }
+        if (record.direction == CaptureProvider::Direction_Read && record.length != 0) {
+            return;
+        }
+        m_pos = data + record.length;
+    }
+    m_pos = m_end;
+}
+
+bool ReplayProvider::next_record(Clock::time_point deadline) {
+    // skip_writes() leaves m_pos on a complete read record or at the end
+    if (m_pos == m_end) {
+        return false;
+    }
+    CaptureProvider::Record record;
+    memcpy(&record, m_pos, sizeof(record));
+    if (m_mode == Mode_Realtime) {
+        if (!m_started) {
+            m_started = true;
+            m_first_timestamp = record.timestamp_ns;
+            m_start = Clock::now();
+        }
+        auto due = m_start + nanoseconds(record.timestamp_ns - m_first_timestamp);
+        if (due > deadline) {
+            std::this_thread::sleep_until(deadline);
+            return false;
+        }
+        std::this_thread::sleep_until(due);
+    }
+    m_record_pos = m_pos + sizeof(record);
+    m_record_end = m_record_pos + record.length;
+    m_pos = m_record_end;
+    skip_writes();
+    return true;
+}
+
+Clock::time_point ReplayProvider::read_deadline(std::size_t count) const {
+    // fast replay never waits, so skip reading the clock
+    if (m_mode == Mode_Fast) {
+        return Clock::time_point::max();
+    }
+    return Clock::now() + milliseconds(m_read_timeout + m_read_multiplier * count);
+}
+
+std::size_t ReplayProvider::take(uint8_t *buffer, std::size_t count, Clock::time_point deadline) {
+    if (m_record_pos == m_record_end && !next_record(deadline)) {
+        return 0;
+    }
+    std::size_t n = std::min<std::size_t>(m_record_end - m_record_pos, count);
+    std::copy(m_record_pos, m_record_pos + n, buffer);
+    m_record_pos += n;
+    return n;
+}
+
+bool ReplayProvider::read(uint8_t *buffer, std::size_t count) {
+    auto deadline = read_deadline(count);
+    while (count) {
+        std::size_t n = take(buffer, count, deadline);
+        if (n == 0) {
+            return false;
+        }
+        buffer += n;
+        count -= n;
+    }
+    return true;
+}
+
+std::size_t ReplayProvider::read_some(uint8_t *buffer, std::size_t count) {
+    return take(buffer, count, read_deadline(0));
+}
+
+const uint8_t *ReplayProvider::read_view(std::size_t &count) {
+    count = 0;
+    if (!m_begin) {
+        return nullptr;
+    }
+    if (m_record_pos == m_record_end && !next_record(read_deadline(0))) {
+        // at the end read_some() reports it as any other provider would; a record
+        // that is not due yet is an empty view, so the wait is not repeated there
+        return m_pos == m_end ? nullptr : m_pos;
+    }
+    const uint8_t *view = m_record_pos;
+    count = m_record_end - m_record_pos;
+    m_record_pos = m_record_end;
+    return view;
+}
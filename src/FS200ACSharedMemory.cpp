@@ -0,0 +1,214 @@
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FS200AC/FS200ACSharedMemory.hpp"
+
+typedef SharedMemoryPublisher::Region Region;
+typedef SharedMemoryPublisher::Slot Slot;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must not hide a lock");
+static_assert(sizeof(FS200AC::Sample) % sizeof(uint64_t) == 0);
+
+static std::string object_name(const char *name) {
+    return name[0] == '/' ? name : std::string("/") + name;
+}
+
+static Slot *slots_of(const Region *region) {
+    std::size_t offset = (sizeof(Region) + 63) & ~(std::size_t)63;
+    return (Slot*)((uint8_t*)region + offset);
+}
+
+// whether name holds a region whose publisher is no longer running
+static bool abandoned(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (std::size_t)st.st_size >= sizeof(Region)) {
+        map = mmap(nullptr, sizeof(Region), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    const Region *region = (const Region*)map;
+    // anything else, including a publisher still setting up, counts as in use
+    bool gone = std::atomic_ref<const uint64_t>(region->magic).load(std::memory_order_acquire) == SharedMemoryPublisher::MAGIC &&
+                region->version == SharedMemoryPublisher::VERSION &&
+                region->owner > 0 && kill(region->owner, 0) != 0 && errno == ESRCH;
+    munmap(map, sizeof(Region));
+    return gone;
+}
+
+std::size_t SharedMemoryPublisher::region_size(std::size_t capacity) {
+    return ((sizeof(Region) + 63) & ~(std::size_t)63) + capacity * sizeof(Slot);
+}
+
+SharedMemoryPublisher::SharedMemoryPublisher(const char *name, std::size_t capacity)
+    : m_name(object_name(name)), m_region(nullptr), m_slots(nullptr), m_size(0), m_mask(0), m_head(0), m_error(0) {
+    capacity = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    // a publisher that crashed left its object behind, with the wrong size for this one
+    if (fd < 0 && errno == EEXIST && abandoned(m_name)) {
+        shm_unlink(m_name.c_str());
+        fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+    }
+    if (fd < 0) {
+        m_error = errno;
+        return;
+    }
+    std::size_t size = region_size(capacity);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    m_error = map == MAP_FAILED ? errno : 0;
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(m_name.c_str());
+        return;
+    }
+    m_region = new (map) Region();
+    m_region->capacity = (uint32_t)capacity;
+    m_region->sample_size = sizeof(FS200AC::Sample);
+    m_region->live_size = sizeof(FS200AC::LiveState);
+    m_region->version = VERSION;
+    m_region->owner = (int32_t)getpid();
+    m_slots = slots_of(m_region);
+    for (std::size_t i = 0; i < capacity; i++) {
+        new (&m_slots[i]) Slot();
+    }
+    m_size = size;
+    m_mask = capacity - 1;
+    // readers check the magic last, so it goes in once everything else is set up
+    std::atomic_thread_fence(std::memory_order_release);
+    std::atomic_ref<uint64_t>(m_region->magic).store(MAGIC, std::memory_order_release);
+}
+
+SharedMemoryPublisher::~SharedMemoryPublisher() {
+    if (m_region) {
+        munmap(m_region, m_size);
+        shm_unlink(m_name.c_str());
+    }
+}
+
+void SharedMemoryPublisher::publish(const FS200AC::Sample &sample) {
+    Slot &slot = m_slots[m_head & m_mask];
+    uint64_t words[sizeof(sample) / sizeof(uint64_t)];
+    memcpy(words, &sample, sizeof(sample));
+    slot.seq.store(2 * m_head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(2 * m_head + 2, std::memory_order_release);
+    m_head++;
+    m_region->head.store(m_head, std::memory_order_release);
+}
+
+void SharedMemoryPublisher::on_sample(const FS200AC::Sample &sample, const FS200AC::LiveState &live) {
+    publish(sample);
+    publish_live(live);
+}
+
+SharedMemorySubscriber::SharedMemorySubscriber(const char *name)
+    : m_region(nullptr), m_slots(nullptr), m_size(0), m_mask(0), m_tail(0), m_lost(0) {
+    int fd = shm_open(object_name(name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (std::size_t)st.st_size >= sizeof(Region)) {
+        map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+    const Region *region = (const Region*)map;
+    bool valid = std::atomic_ref<const uint64_t>(region->magic).load(std::memory_order_acquire) == SharedMemoryPublisher::MAGIC &&
+                 region->version == SharedMemoryPublisher::VERSION &&
+                 region->sample_size == sizeof(FS200AC::Sample) &&
+                 region->live_size == sizeof(FS200AC::LiveState) &&
+                 std::has_single_bit(region->capacity) &&
+                 SharedMemoryPublisher::region_size(region->capacity) <= (std::size_t)st.st_size;
+    if (!valid) {
+        munmap(map, st.st_size);
+        return;
+    }
+    m_region = region;
+    m_slots = slots_of(region);
+    m_size = st.st_size;
+    m_mask = region->capacity - 1;
+    seek_latest();
+}
+
+SharedMemorySubscriber::~SharedMemorySubscriber() {
+    if (m_region) {
+        munmap((void*)m_region, m_size);
+    }
+}
+
+void SharedMemorySubscriber::seek_latest() {
+    m_tail = m_region->head.load(std::memory_order_acquire);
+}
+
+bool SharedMemorySubscriber::pop(FS200AC::Sample &sample) {
+    for (;;) {
+        const Slot &slot = m_slots[m_tail & m_mask];
+        uint64_t expected = 2 * m_tail + 2;
+        uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if (before < expected) {
+            // not written yet, or still being written
+            return false;
+        }
+        if (before == expected) {
+            uint64_t words[sizeof(sample) / sizeof(uint64_t)];
+            for (std::size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == expected) {
+                memcpy((void*)&sample, words, sizeof(sample));
+                m_tail++;
+                return true;
+            }
+        }
+        // lapped by the publisher: skip to the oldest sample still in the ring
+        uint64_t head = m_region->head.load(std::memory_order_acquire);
+        uint64_t oldest = head > m_mask + 1 ? head - (m_mask + 1) : 0;
+        if (oldest <= m_tail) {
+            oldest = m_tail + 1;
+        }
+        m_lost += oldest - m_tail;
+        m_tail = oldest;
+    }
+}
+
+std::size_t SharedMemorySubscriber::pop(FS200AC::Sample *samples, std::size_t count) {
+    std::size_t n = 0;
+    while (n < count && pop(samples[n])) {
+        n++;
+    }
+    return n;
+}
+
+bool SharedMemorySubscriber::live_state(FS200AC::LiveState &live) const {
+    for (int i = 0; i < 1000; i++) {
+        if (m_region->live.try_load(live)) {
+            return true;
+        }
+    }
+    return false;
+}
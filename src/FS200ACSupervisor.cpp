@@ -0,0 +1,187 @@
+#include "FS200AC/FS200ACSupervisor.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+FS200ACSupervisor::Options::Options()
+    : stall_timeout(300), retry_interval(50), queue_capacity(1024) {
+}
+
+FS200ACSupervisor::FS200ACSupervisor(ProviderFactory factory, const FS200AC::ConsoleState *initial_state, const Options &options)
+    : m_factory(std::move(factory)), m_options(options), m_fs(m_link), m_samples(options.queue_capacity), m_dropped(0),
+      m_status(Stopped), m_stopping(false), m_reopens(0), m_reattaches(0), m_use_default_state(initial_state == nullptr),
+      m_initial_state(), m_state_version(0) {
+    // failures are retried rather than asserted on
+    m_fs.set_resilient(true);
+    if (initial_state) {
+        m_initial_state = *initial_state;
+    }
+}
+
+FS200ACSupervisor::~FS200ACSupervisor() {
+    stop();
+}
+
+bool FS200ACSupervisor::start() {
+    if (m_thread.joinable()) {
+        return false;
+    }
+    m_stopping.store(false);
+    m_status.store(Connecting);
+    m_thread = std::thread(&FS200ACSupervisor::run, this);
+    return true;
+}
+
+void FS200ACSupervisor::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_stopping.store(true);
+    m_thread.join();
+    m_status.store(Stopped);
+}
+
+bool FS200ACSupervisor::pop(FS200AC::Sample &sample) {
+    return m_samples.pop(sample);
+}
+
+std::size_t FS200ACSupervisor::pop(FS200AC::Sample *samples, std::size_t count) {
+    return m_samples.pop(samples, count);
+}
+
+void FS200ACSupervisor::update_console(const FS200AC::ConsoleState &state) {
+    std::lock_guard<std::mutex> lock(m_state_mutex);
+    m_initial_state = state;
+    m_use_default_state = false;
+    m_state_version++;
+    // refused until the first initialize(), which then picks up m_initial_state
+    m_fs.update_console(state);
+}
+
+bool FS200ACSupervisor::initialize() {
+    bool use_default_state;
+    FS200AC::ConsoleState state;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(m_state_mutex);
+        use_default_state = m_use_default_state;
+        state = m_initial_state;
+        version = m_state_version;
+    }
+    FS200AC::ControlsState controls;
+    if (!(use_default_state ? m_fs.initialize(controls) : m_fs.initialize(controls, state))) {
+        return false;
+    }
+    // an update that arrived while initializing may have been refused
+    std::lock_guard<std::mutex> lock(m_state_mutex);
+    if (m_state_version != version) {
+        m_fs.update_console(m_initial_state);
+    }
+    return true;
+}
+
+void FS200ACSupervisor::run() {
+    bool initialized = false;
+    bool outage = false;
+    // stalls are timed from the last frame or attach, outages from the last frame
+    Clock::time_point last_frame = Clock::now();
+    Clock::time_point stall_from = last_frame;
+    FS200AC::Sample samples[64];
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (!m_link.connected()) {
+            m_status.store(Connecting);
+            // the old port goes first, its replacement may well have the same name
+            bool reopen = initialized;
+            m_link.close();
+            if (!m_link.open(m_factory)) {
+                std::this_thread::sleep_for(m_options.retry_interval);
+                continue;
+            }
+            if (reopen) {
+                m_reopens.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (m_status.load(std::memory_order_relaxed) != Streaming) {
+            m_status.store(Attaching);
+            if (!(initialized ? m_fs.reattach() : initialize())) {
+                std::this_thread::sleep_for(m_options.retry_interval);
+                continue;
+            }
+            if (initialized) {
+                m_reattaches.fetch_add(1, std::memory_order_relaxed);
+            }
+            initialized = true;
+            stall_from = Clock::now();
+            m_status.store(Streaming, std::memory_order_release);
+        }
+        std::size_t count = m_fs.poll_batch(samples, Clock::now() + m_fs.timeouts().frame);
+        if (count) {
+            for (std::size_t i = 0; i < count; i++) {
+                if (!m_samples.push(samples[i])) {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            if (outage) {
+                m_outages.record(std::chrono::duration_cast<std::chrono::microseconds>(samples[0].timestamp - last_frame));
+                outage = false;
+            }
+            last_frame = samples[count - 1].timestamp;
+            stall_from = last_frame;
+            continue;
+        }
+        // A missed frame alone is not an outage, the console may just be slow. One
+        // cut off part way is: the console sends frames in one go, so the stream
+        // broke. That is not taken for a reboot, reattach() probes for a banner or
+        // silence and only sets up a console that turns out to have rebooted.
+        FS200AC::Error error = m_fs.last_error();
+        bool lost = error == FS200AC::Error_LinkLost || !m_link.connected();
+        bool broken = error == FS200AC::Error_Rebooted || error == FS200AC::Error_PartialFrame;
+        if (lost || broken || Clock::now() - stall_from >= m_options.stall_timeout) {
+            outage = true;
+            m_status.store(lost ? Connecting : Attaching);
+        }
+    }
+}
+
+bool FS200ACSupervisor::Link::open(const ProviderFactory &factory) {
+    m_port = factory();
+    if (m_port && !m_port->connected()) {
+        m_port.reset();
+    }
+    return m_port != nullptr;
+}
+
+void FS200ACSupervisor::Link::setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) {
+    if (m_port) {
+        m_port->setReadTimeout(multiplier, timeout_ms);
+    }
+}
+
+void FS200ACSupervisor::Link::setWriteTimeout(unsigned int multiplier) {
+    if (m_port) {
+        m_port->setWriteTimeout(multiplier);
+    }
+}
+
+bool FS200ACSupervisor::Link::read(uint8_t *buffer, std::size_t count) {
+    return m_port && m_port->read(buffer, count);
+}
+
+bool FS200ACSupervisor::Link::write(const uint8_t *buffer, std::size_t count) {
+    return m_port && m_port->write(buffer, count);
+}
+
+std::size_t FS200ACSupervisor::Link::read_some(uint8_t *buffer, std::size_t count) {
+    return m_port ? m_port->read_some(buffer, count) : 0;
+}
+
+std::size_t FS200ACSupervisor::Link::write_some(const uint8_t *buffer, std::size_t count) {
+    return m_port ? m_port->write_some(buffer, count) : 0;
+}
+
+const uint8_t *FS200ACSupervisor::Link::read_view(std::size_t &count) {
+    if (!m_port) {
+        count = 0;
+        return nullptr;
+    }
+    return m_port->read_view(count);
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cstring>
+#include <inttypes.h>
+
+#include "FS200AC/FS200ACTrace.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// how long the formatter sleeps once the rings are empty
+static const std::chrono::milliseconds FORMAT_INTERVAL(10);
+// Entries are held back until every ring has passed their timestamp, so that one
+// recorded late on another thread still comes out in order. A ring that stays
+// quiet stops holding the others back after this long.
+static const std::chrono::milliseconds HOLD_BACK(200);
+
+static std::atomic<uint64_t> next_trace_id(1);
+
+static const char *error_name(uint8_t error) {
+    static const char *const names[] = {
+        "none", "timeout", "checksum", "partial frame", "write",
+        "reset", "controls", "setup", "link lost", "rebooted",
+    };
+    return error < sizeof(names) / sizeof(names[0]) ? names[error] : "unknown";
+}
+
+FS200ACTrace::FS200ACTrace(FILE *out, std::size_t capacity)
+    : m_out(out), m_capacity(capacity), m_id(next_trace_id.fetch_add(1)),
+      m_kinds((1u << Kind_Frame) | (1u << Kind_Write) | (1u << Kind_Error)), m_start(Clock::now()),
+      m_running(false), m_written(0) {
+}
+
+FS200ACTrace::~FS200ACTrace() {
+    stop();
+}
+
+bool FS200ACTrace::start() {
+    if (m_thread.joinable()) {
+        return false;
+    }
+    m_running.store(true);
+    m_thread = std::thread(&FS200ACTrace::run, this);
+    return true;
+}
+
+void FS200ACTrace::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_running.store(false);
+    m_thread.join();
+}
+
+FS200ACTrace::Buffer *FS200ACTrace::local_buffer() {
+    // a thread usually records into one trace, anything else takes the lock
+    thread_local uint64_t cached_id = 0;
+    thread_local Buffer *cached = nullptr;
+    if (cached_id == m_id) {
+        return cached;
+    }
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(m_buffers_mutex);
+    auto found = std::find_if(m_buffers.begin(), m_buffers.end(),
+                              [&](const std::unique_ptr<Buffer> &buffer) { return buffer->owner == self; });
+    if (found == m_buffers.end()) {
+        // the buffer of a thread that exited is taken over by one that reuses its id
+        m_buffers.emplace_back(new Buffer(m_capacity, self));
+        found = m_buffers.end() - 1;
+    }
+    cached_id = m_id;
+    cached = found->get();
+    return cached;
+}
+
+void FS200ACTrace::record(const Entry &entry) {
+    Buffer *buffer = local_buffer();
+    if (!buffer->ring.push(entry)) {
+        buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+void FS200ACTrace::record_frame(const FS200AC::Sample &sample, const uint8_t data[8]) {
+    Entry entry;
+    entry.timestamp = sample.timestamp;
+    entry.kind = Kind_Frame;
+    entry.length = 9;
+    entry.error = 0;
+    entry.roll = sample.roll;
+    entry.pitch = sample.pitch;
+    entry.yaw = sample.yaw;
+    entry.event = sample.event;
+    entry.bytes[0] = 0xa5;
+    memcpy(entry.bytes + 1, data, 8);
+    record(entry);
+}
+
+void FS200ACTrace::record_bytes(Kind kind, Clock::time_point timestamp, const uint8_t *bytes, std::size_t count) {
+    Entry entry;
+    entry.timestamp = timestamp;
+    entry.kind = kind;
+    entry.error = 0;
+    entry.roll = entry.pitch = entry.yaw = 0;
+    entry.event = FS200AC::Event();
+    while (count) {
+        entry.length = (uint8_t)std::min(count, sizeof(entry.bytes));
+        memcpy(entry.bytes, bytes, entry.length);
+        record(entry);
+        bytes += entry.length;
+        count -= entry.length;
+    }
+}
+
+void FS200ACTrace::record_error(Clock::time_point timestamp, FS200AC::Error error) {
+    Entry entry;
+    entry.timestamp = timestamp;
+    entry.kind = Kind_Error;
+    entry.length = 0;
+    entry.error = (uint8_t)error;
+    entry.roll = entry.pitch = entry.yaw = 0;
+    entry.event = FS200AC::Event();
+    record(entry);
+}
+
+uint64_t FS200ACTrace::dropped() const {
+    std::lock_guard<std::mutex> lock(m_buffers_mutex);
+    uint64_t dropped = 0;
+    for (const auto &buffer : m_buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void FS200ACTrace::run() {
+    // entries drained but held back, oldest first
+    std::vector<Entry> entries;
+    bool running = true;
+    while (running) {
+        // read before draining so that the last pass sees everything recorded before stop()
+        running = m_running.load();
+        if (!drain(entries, !running) && running) {
+            std::this_thread::sleep_for(FORMAT_INTERVAL);
+        }
+    }
+}
+
+std::size_t FS200ACTrace::drain(std::vector<Entry> &entries, bool final) {
+    std::vector<Buffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_buffers_mutex);
+        for (const auto &buffer : m_buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+    // taken before draining: a quiet ring can only still deliver entries stamped after this
+    Clock::time_point horizon = final ? Clock::time_point::max() : Clock::now() - HOLD_BACK;
+    Clock::time_point passed = Clock::time_point::max();
+    for (Buffer *buffer : buffers) {
+        std::size_t count = buffer->ring.size();
+        std::size_t offset = entries.size();
+        entries.resize(offset + count);
+        entries.resize(offset + buffer->ring.pop(entries.data() + offset, count));
+        // rings are in order on their own
+        if (entries.size() > offset) {
+            buffer->latest = entries.back().timestamp;
+        }
+        passed = std::min(passed, std::max(buffer->latest, horizon));
+    }
+    // entries from different threads are interleaved here, held back ones stay ahead of equal new ones
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry &a, const Entry &b) { return a.timestamp < b.timestamp; });
+    auto end = std::upper_bound(entries.begin(), entries.end(), passed,
+                                [](Clock::time_point timestamp, const Entry &entry) { return timestamp < entry.timestamp; });
+    std::size_t count = end - entries.begin();
+    if (!count) {
+        return 0;
+    }
+    for (auto entry = entries.begin(); entry != end; ++entry) {
+        format(*entry);
+    }
+    fflush(m_out);
+    entries.erase(entries.begin(), end);
+    m_written.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+void FS200ACTrace::format(const Entry &entry) {
+    static const char *const kinds[] = {"frame", "read", "write", "error"};
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(entry.timestamp - m_start).count();
+    fprintf(m_out, "%s%" PRId64 ".%06" PRId64 " %-5s", us < 0 ? "-" : "", (us < 0 ? -us : us) / 1000000,
+            (us < 0 ? -us : us) % 1000000, entry.kind <= Kind_Error ? kinds[entry.kind] : "?");
+    if (entry.kind == Kind_Error) {
+        fprintf(m_out, " %s\n", error_name(entry.error));
+        return;
+    }
+    if (entry.kind == Kind_Frame) {
+        const FS200AC::Event &event = entry.event;
+        const char *name = FS200AC::control_name(event.control);
+        name = name ? name : "-";
+        switch (event.type) {
+            case FS200AC::None:
+                fprintf(m_out, " %-8s %-24s %-6s", "none", "", "");
+                break;
+            case FS200AC::Button:
+                fprintf(m_out, " %-8s %-24s %-6s", "button", name, "");
+                break;
+            case FS200AC::Slider:
+                fprintf(m_out, " %-8s %-24s %-6u", "slider", name, event.slider);
+                break;
+            case FS200AC::Toggle:
+                fprintf(m_out, " %-8s %-24s %-6s", "toggle", name, event.toggle ? "on" : "off");
+                break;
+            case FS200AC::Switch:
+                fprintf(m_out, " %-8s %-24s %-6u", "switch", name, event.switch_);
+                break;
+            case FS200AC::Knob:
+                fprintf(m_out, " %-8s %-24s %-6u", "knob", name, event.knob);
+                break;
+        }
+        fprintf(m_out, " roll %4d pitch %4d yaw %4d |", entry.roll, entry.pitch, entry.yaw);
+    }
+    for (uint8_t i = 0; i < entry.length; i++) {
+        fprintf(m_out, " %02x", entry.bytes[i]);
+    }
+    fputc('\n', m_out);
+}
@@ -0,0 +1,213 @@
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "FS200AC/LinuxSerialProvider.hpp"
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+
+typedef std::chrono::steady_clock Clock;
+
+LinuxSerialProvider::LinuxSerialProvider(const char *path, bool low_latency)
+    : LinuxSerialProvider(::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC), low_latency) {
+    m_path = path;
+}
+
+LinuxSerialProvider::LinuxSerialProvider(int fd, bool low_latency)
+    : m_fd(fd), m_epoll(-1), m_events(0), m_low_latency(false), m_lost(false),
+      m_read_multiplier(0), m_read_constant(0), m_write_multiplier(0) {
+    if (m_fd < 0) {
+        return;
+    }
+    configure(low_latency);
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = m_events = EPOLLIN;
+    ev.data.fd = m_fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_fd, &ev);
+}
+
+LinuxSerialProvider::~LinuxSerialProvider() {
+    if (m_epoll >= 0) {
+        close(m_epoll);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+void LinuxSerialProvider::configure(bool low_latency) {
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+    termios tio;
+    if (tcgetattr(m_fd, &tio) == 0) {
+        // 9600 8N1, raw, no flow control
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B9600);
+        cfsetospeed(&tio, B9600);
+        tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+        tio.c_cflag |= CS8 | CLOCAL | CREAD;
+        // reads never block in the kernel, waiting is done with epoll
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(m_fd, TCSANOW, &tio);
+    }
+
+    int rts = TIOCM_RTS;
+    ioctl(m_fd, TIOCMBIC, &rts);
+
+    if (low_latency) {
+        // asks the driver (e.g. ftdi_sio) to push received bytes up immediately
+        // instead of batching them on its latency timer
+        serial_struct serial;
+        if (ioctl(m_fd, TIOCGSERIAL, &serial) == 0) {
+            serial.flags |= ASYNC_LOW_LATENCY;
+            m_low_latency = ioctl(m_fd, TIOCSSERIAL, &serial) == 0;
+        }
+    }
+}
+
+bool LinuxSerialProvider::transient(int error) {
+    if (error == EAGAIN || error == EINTR) {
+        return true;
+    }
+    // EIO and friends: the device went away, or the other end of a pty closed
+    m_lost = true;
+    return false;
+}
+
+bool LinuxSerialProvider::wait(uint32_t events, int timeout_ms) {
+    if (events != m_events) {
+        epoll_event ev = {};
+        ev.events = m_events = events;
+        ev.data.fd = m_fd;
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, m_fd, &ev);
+    }
+    epoll_event ev;
+    int count;
+    do {
+        count = epoll_wait(m_epoll, &ev, 1, timeout_ms);
+    } while (count < 0 && errno == EINTR);
+    // a hung up tty reads as empty forever, only epoll tells it apart
+    if (count > 0 && (ev.events & (EPOLLHUP | EPOLLERR))) {
+        m_lost = true;
+        return false;
+    }
+    return count > 0;
+}
+
+void LinuxSerialProvider::setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) {
+    m_read_multiplier = multiplier;
+    m_read_constant = timeout_ms;
+}
+
+void LinuxSerialProvider::setWriteTimeout(unsigned int multiplier) {
+    m_write_multiplier = multiplier;
+}
+
+bool LinuxSerialProvider::read(uint8_t *buffer, std::size_t count) {
+    if (m_fd < 0) {
+        return false;
+    }
+    auto deadline = Clock::now() + milliseconds(m_read_constant + m_read_multiplier * count);
+    while (count) {
+        ssize_t n = ::read(m_fd, buffer, count);
+        if (n > 0) {
+            buffer += n;
+            count -= n;
+            continue;
+        }
+        // with VMIN = VTIME = 0 an empty tty reads as 0 rather than EAGAIN
+        if (n < 0 && !transient(errno)) {
+            return false;
+        }
+        auto remaining = duration_cast<milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0 || !wait(EPOLLIN, (int)remaining)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t LinuxSerialProvider::read_some(uint8_t *buffer, std::size_t count) {
+    if (m_fd < 0) {
+        return 0;
+    }
+    auto deadline = Clock::now() + milliseconds(m_read_constant + m_read_multiplier);
+    for (;;) {
+        ssize_t n = ::read(m_fd, buffer, count);
+        if (n > 0) {
+            return n;
+        }
+        // with VMIN = VTIME = 0 an empty tty reads as 0 rather than EAGAIN
+        if (n < 0 && !transient(errno)) {
+            return 0;
+        }
+        auto remaining = duration_cast<milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0 || !wait(EPOLLIN, (int)remaining)) {
+            return 0;
+        }
+    }
+}
+
+bool LinuxSerialProvider::write(const uint8_t *buffer, std::size_t count) {
+    if (m_fd < 0) {
+        return false;
+    }
+    auto deadline = Clock::now() + milliseconds(m_write_multiplier * count);
+    while (count) {
+        ssize_t n = ::write(m_fd, buffer, count);
+        if (n > 0) {
+            buffer += n;
+            count -= n;
+            continue;
+        }
+        if (n < 0 && !transient(errno)) {
+            return false;
+        }
+        auto remaining = duration_cast<milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0 || !wait(EPOLLOUT, (int)remaining)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t LinuxSerialProvider::write_some(const uint8_t *buffer, std::size_t count) {
+    if (m_fd < 0) {
+        return 0;
+    }
+    ssize_t n = ::write(m_fd, buffer, count);
+    if (n < 0) {
+        transient(errno);
+        return 0;
+    }
+    return n;
+}
+
+bool LinuxSerialProvider::open_pty_pair(int &master, int &slave) {
+    master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master < 0) {
+        return false;
+    }
+    char name[64];
+    if (grantpt(master) != 0 || unlockpt(master) != 0 ||
+        ptsname_r(master, name, sizeof(name)) != 0) {
+        close(master);
+        return false;
+    }
+    slave = ::open(name, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (slave < 0) {
+        close(master);
+        return false;
+    }
+    return true;
+}
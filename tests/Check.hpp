@@ -0,0 +1,70 @@
+#ifndef FS200AC_TESTS_CHECK_HPP
+#define FS200AC_TESTS_CHECK_HPP
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Just enough of a test harness to keep the library free of dependencies. Each
+// test executable registers its cases with TEST() and runs them from
+// run_tests(); CHECK() reports a failure and carries on with the case.
+
+struct TestCase {
+    const char *name;
+    std::function<void()> run;
+};
+
+inline std::vector<TestCase> &test_cases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int &check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct TestRegistration {
+    TestRegistration(const char *name, std::function<void()> run) { test_cases().push_back({name, std::move(run)}); }
+};
+
+#define TEST_CONCAT2(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT2(a, b)
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration TEST_CONCAT(name, _registration)(#name, name); \
+    static void name()
+
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            check_failures()++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        auto check_a = (a); \
+        auto check_b = (b); \
+        if (!(check_a == check_b)) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, \
+                    (long long)check_a, (long long)check_b); \
+            check_failures()++; \
+        } \
+    } while (0)
+
+inline int run_tests() {
+    int failed = 0;
+    for (const TestCase &test : test_cases()) {
+        int before = check_failures();
+        test.run();
+        bool passed = check_failures() == before;
+        printf("%s %s\n", passed ? "PASS" : "FAIL", test.name);
+        failed += !passed;
+    }
+    printf("%zu cases, %d failed\n", test_cases().size(), failed);
+    return failed ? 1 : 0;
+}
+
+#endif
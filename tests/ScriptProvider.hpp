@@ -0,0 +1,65 @@
+#ifndef FS200AC_TESTS_SCRIPTPROVIDER_HPP
+#define FS200AC_TESTS_SCRIPTPROVIDER_HPP
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/VirtualClock.hpp>
+
+#include "FS200ACProtocol.hpp"
+
+// SerialProvider that plays back bytes scheduled on a VirtualClock and keeps
+// everything the host writes. Reads never wait: whatever is due by the clock's
+// current time is returned, so the host's own timeouts move the clock along.
+class ScriptProvider : public FS200AC::SerialProvider {
+    public:
+    explicit ScriptProvider(VirtualClock &clock) : m_clock(clock) {}
+
+    // bytes that become readable at at
+    void at(VirtualClock::time_point at, const uint8_t *bytes, std::size_t count) {
+        for (std::size_t i = 0; i < count; i++) {
+            m_input.push_back({at, bytes[i]});
+        }
+    }
+    void at(std::chrono::milliseconds at, const uint8_t *bytes, std::size_t count) {
+        this->at(VirtualClock::time_point(at), bytes, count);
+    }
+    void frame_at(std::chrono::milliseconds at, int8_t roll, int8_t pitch, int8_t yaw, uint8_t id = 0, uint8_t b2 = 0, uint8_t b3 = 0) {
+        uint8_t frame[9];
+        encode_frame(roll, pitch, yaw, id, b2, b3, frame);
+        this->at(at, frame, sizeof(frame));
+    }
+
+    const std::vector<uint8_t> &written() const { return m_written; }
+    std::size_t pending() const { return m_input.size(); }
+
+    virtual void setReadTimeout(unsigned int, unsigned int) {}
+    virtual void setWriteTimeout(unsigned int) {}
+    virtual bool read(uint8_t *buffer, std::size_t count) { return read_some(buffer, count) == count; }
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count) {
+        std::size_t n = 0;
+        while (n < count && !m_input.empty() && m_input.front().at <= m_clock.now()) {
+            buffer[n++] = m_input.front().byte;
+            m_input.pop_front();
+        }
+        return n;
+    }
+    virtual bool write(const uint8_t *buffer, std::size_t count) {
+        m_written.insert(m_written.end(), buffer, buffer + count);
+        return true;
+    }
+
+    private:
+    struct Input {
+        VirtualClock::time_point at;
+        uint8_t byte;
+    };
+
+    VirtualClock &m_clock;
+    std::deque<Input> m_input;
+    std::vector<uint8_t> m_written;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <thread>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+
+#include "Check.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using namespace std::chrono_literals;
+
+// A streaming console whose samples are taken by the acquisition thread, on
+// real time since that thread and the test both wait for each other.
+struct Acquisition {
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port;
+    FS200AC fs;
+
+    explicit Acquisition(double frame_rate) : emulator(options(frame_rate)), port(emulator), fs(port) {
+        fs.set_resilient(true);
+        fs.set_reset_on_destroy(false);
+        FS200AC::ControlsState controls;
+        CHECK(fs.initialize(controls));
+    }
+
+    static FS200ACEmulator::Options options(double frame_rate) {
+        FS200ACEmulator::Options options;
+        options.synthetic = true;
+        options.frame_rate = frame_rate;
+        return options;
+    }
+};
+
+// synthetic frames step the roll by 3 (mod 255) from one frame to the next
+static bool consecutive(const FS200AC::Sample &a, const FS200AC::Sample &b) {
+    return (b.roll - a.roll + 255) % 255 == 3;
+}
+
+TEST(samples_arrive_in_order) {
+    Acquisition acquisition(200);
+    FS200AC &fs = acquisition.fs;
+    CHECK(fs.start_acquisition(64));
+    CHECK(fs.acquiring());
+    // a second reader thread is refused
+    CHECK(!fs.start_acquisition(64));
+    FS200AC::Sample samples[40];
+    std::size_t count = 0;
+    auto deadline = Clock::now() + 2s;
+    while (count < 40 && Clock::now() < deadline) {
+        count += fs.pop_samples(samples + count, 40 - count);
+        std::this_thread::sleep_for(2ms);
+    }
+    fs.stop_acquisition();
+    CHECK(!fs.acquiring());
+    CHECK_EQ(count, 40u);
+    for (std::size_t i = 1; i < count; i++) {
+        CHECK(consecutive(samples[i - 1], samples[i]));
+        CHECK(samples[i].timestamp >= samples[i - 1].timestamp);
+    }
+    CHECK_EQ(fs.dropped_samples(), 0u);
+}
+
+TEST(full_ring_drops_and_counts_new_samples) {
+    // as fast as frames are acknowledged, so the ring fills at once
+    Acquisition acquisition(0);
+    FS200AC &fs = acquisition.fs;
+    // rounded up to 8
+    CHECK(fs.start_acquisition(5));
+    auto deadline = Clock::now() + 2s;
+    while (fs.dropped_samples() < 100 && Clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    fs.stop_acquisition();
+    CHECK(fs.dropped_samples() >= 100u);
+    FS200AC::Sample samples[16];
+    std::size_t count = fs.pop_samples(samples, 16);
+    CHECK_EQ(count, 8u);
+    // the oldest samples are kept
+    for (std::size_t i = 1; i < count; i++) {
+        CHECK(consecutive(samples[i - 1], samples[i]));
+    }
+    CHECK_EQ(fs.stats().frames, acquisition.emulator.frames_acknowledged());
+    CHECK_EQ(fs.stats().frames, count + fs.dropped_samples());
+}
+
+int main() {
+    return run_tests();
+}
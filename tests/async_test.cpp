@@ -0,0 +1,178 @@
+#include <FS200AC/EpollReactor.hpp>
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/LinuxSerialProvider.hpp>
+
+#include "Check.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::milliseconds;
+using namespace std::chrono_literals;
+
+// runs the reactor until task is done, returning the longest single run_once()
+static Clock::duration run(EpollReactor &reactor, Task<bool> &task) {
+    Clock::duration longest(0);
+    task.start();
+    while (!task.done()) {
+        auto start = Clock::now();
+        reactor.run_once(10ms);
+        longest = std::max(longest, Clock::now() - start);
+    }
+    return longest;
+}
+
+static FS200ACEmulator::Options streaming(bool boot_banner = true) {
+    FS200ACEmulator::Options options;
+    options.synthetic = true;
+    options.frame_rate = 200;
+    options.boot_banner = boot_banner;
+    return options;
+}
+
+TEST(initialize_and_poll_without_a_native_handle) {
+    FS200ACEmulator emulator(streaming());
+    FS200ACEmulator::Provider port(emulator);
+    FS200AC fs(port);
+    fs.set_resilient(true);
+    fs.set_reset_on_destroy(false);
+    EpollReactor reactor;
+    FS200AC::ControlsState controls;
+    Task<bool> initialize = fs.initialize_async(reactor, controls);
+    run(reactor, initialize);
+    CHECK(initialize.result());
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Streaming);
+    int frames = 0;
+    for (int i = 0; i < 20; i++) {
+        FS200AC::Sample sample;
+        Task<bool> poll = fs.poll_async(reactor, sample);
+        run(reactor, poll);
+        frames += poll.result();
+    }
+    CHECK_EQ(frames, 20);
+}
+
+TEST(silent_console_never_blocks_the_reactor) {
+    FS200ACEmulator emulator(streaming(false));
+    FS200ACEmulator::PtyServer server(emulator);
+    CHECK(server.start());
+    LinuxSerialProvider port(server.slave_name().c_str());
+    CHECK(port.native_handle() >= 0);
+    FS200AC fs(port);
+    fs.set_resilient(true);
+    fs.set_reset_on_destroy(false);
+    FS200AC::Timeouts timeouts = {};
+    timeouts.frame = 100ms;
+    fs.set_timeouts(timeouts);
+    EpollReactor reactor;
+    FS200AC::ControlsState controls;
+    Task<bool> initialize = fs.initialize_async(reactor, controls);
+    run(reactor, initialize);
+    CHECK(initialize.result());
+
+    // the handshake leaves a long read timeout behind, the wait must not use it
+    emulator.power_cycle();
+    FS200AC::Sample sample;
+    bool polled = true;
+    Clock::duration longest(0);
+    auto start = Clock::now();
+    // frames already on their way are read first
+    for (int i = 0; i < 10 && polled; i++) {
+        Task<bool> poll = fs.poll_async(reactor, sample);
+        longest = run(reactor, poll);
+        polled = poll.result();
+    }
+    CHECK(!polled);
+    CHECK(Clock::now() - start >= 100ms);
+    CHECK(longest < 50ms);
+    reactor.remove(port.native_handle());
+}
+
+// the emulator behind a cable that can be pulled, or that takes one byte at a
+// time from every other write_some() as a congested port would
+struct UnpluggablePort : public FS200AC::SerialProvider {
+    FS200ACEmulator::Provider port;
+    bool plugged;
+    bool congested;
+    int blocking_writes;
+    int write_attempts;
+
+    explicit UnpluggablePort(FS200ACEmulator &emulator)
+        : port(emulator), plugged(true), congested(false), blocking_writes(0), write_attempts(0) {}
+    virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) { port.setReadTimeout(multiplier, timeout_ms); }
+    virtual void setWriteTimeout(unsigned int multiplier) { port.setWriteTimeout(multiplier); }
+    virtual bool read(uint8_t *buffer, std::size_t count) { return plugged && port.read(buffer, count); }
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count) { return plugged ? port.read_some(buffer, count) : 0; }
+    virtual bool write(const uint8_t *buffer, std::size_t count) {
+        blocking_writes++;
+        return plugged && port.write(buffer, count);
+    }
+    virtual std::size_t write_some(const uint8_t *buffer, std::size_t count) {
+        if (!plugged || (congested && write_attempts++ % 2 == 0)) {
+            return 0;
+        }
+        count = congested ? 1 : count;
+        return port.write(buffer, count) ? count : 0;
+    }
+    virtual bool connected() { return plugged; }
+};
+
+// pulls the cable after count samples, then counts what the stream still yields
+static Task<bool> unplug_after(AsyncGenerator<FS200AC::Sample> &stream, UnpluggablePort &port, int count, int &samples) {
+    for (;;) {
+        const FS200AC::Sample *sample = co_await stream.next();
+        if (!sample) {
+            break;
+        }
+        if (++samples == count) {
+            port.plugged = false;
+        }
+    }
+    co_return true;
+}
+
+TEST(handshake_writes_wait_on_the_reactor) {
+    FS200ACEmulator emulator(streaming());
+    UnpluggablePort port(emulator);
+    port.congested = true;
+    FS200AC fs(port);
+    fs.set_resilient(true);
+    fs.set_reset_on_destroy(false);
+    EpollReactor reactor;
+    FS200AC::ControlsState controls;
+    Task<bool> initialize = fs.initialize_async(reactor, controls);
+    run(reactor, initialize);
+    CHECK(initialize.result());
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Streaming);
+    // the setup packet alone took more than one attempt per byte
+    CHECK(port.write_attempts > 64);
+    CHECK_EQ(port.blocking_writes, 0);
+}
+
+TEST(stream_ends_when_the_link_is_lost) {
+    FS200ACEmulator emulator(streaming());
+    UnpluggablePort port(emulator);
+    FS200AC fs(port);
+    fs.set_resilient(true);
+    fs.set_reset_on_destroy(false);
+    EpollReactor reactor;
+    FS200AC::ControlsState controls;
+    Task<bool> initialize = fs.initialize_async(reactor, controls);
+    run(reactor, initialize);
+    CHECK(initialize.result());
+
+    AsyncGenerator<FS200AC::Sample> stream = fs.poll_stream(reactor);
+    int samples = 0;
+    Task<bool> consumer = unplug_after(stream, port, 10, samples);
+    consumer.start();
+    auto deadline = Clock::now() + 2s;
+    while (!consumer.done() && Clock::now() < deadline) {
+        reactor.run_once(10ms);
+    }
+    CHECK(consumer.done());
+    CHECK_EQ(samples, 10);
+    CHECK_EQ(fs.last_error(), FS200AC::Error_LinkLost);
+}
+
+int main() {
+    return run_tests();
+}
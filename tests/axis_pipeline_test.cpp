@@ -0,0 +1,124 @@
+#include <cmath>
+
+#include <FS200AC/AxisPipeline.hpp>
+
+#include "Check.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using namespace std::chrono_literals;
+
+static bool near(float a, float b) {
+    return std::fabs(a - b) < 1e-4f;
+}
+
+static FS200AC::Sample sample(Clock::time_point timestamp, int8_t roll, int8_t pitch = 0, int8_t yaw = 0) {
+    FS200AC::Sample sample = {};
+    sample.timestamp = timestamp;
+    sample.roll = roll;
+    sample.pitch = pitch;
+    sample.yaw = yaw;
+    return sample;
+}
+
+// the conditioned roll for a single raw value, with the filter passing it through
+static float roll_for(const AxisPipeline::AxisConfig &config, int8_t raw) {
+    AxisPipeline pipeline;
+    pipeline.configure(AxisPipeline::Axis_Roll, config);
+    return pipeline.process(sample(Clock::time_point(), raw)).value[AxisPipeline::Axis_Roll];
+}
+
+TEST(defaults_scale_to_full_range) {
+    AxisPipeline::AxisConfig config;
+    CHECK(near(roll_for(config, 0), 0.0f));
+    CHECK(near(roll_for(config, 127), 1.0f));
+    CHECK(near(roll_for(config, -127), -1.0f));
+    CHECK(near(roll_for(config, -128), -1.0f));
+    CHECK(near(roll_for(config, 64), 64.0f / 127));
+}
+
+TEST(deadzone_reads_as_center_and_keeps_full_scale) {
+    AxisPipeline::AxisConfig config;
+    config.deadzone = 0.1f;
+    CHECK(near(roll_for(config, 12), 0.0f));
+    CHECK(near(roll_for(config, -12), 0.0f));
+    CHECK(near(roll_for(config, 64), (64.0f / 127 - 0.1f) / 0.9f));
+    CHECK(near(roll_for(config, -64), -(64.0f / 127 - 0.1f) / 0.9f));
+    CHECK(near(roll_for(config, 127), 1.0f));
+}
+
+TEST(expo_and_invert_shape_the_curve) {
+    AxisPipeline::AxisConfig config;
+    config.expo = 1.0f;
+    float x = 64.0f / 127;
+    CHECK(near(roll_for(config, 64), x * x * x));
+    config.expo = 0.5f;
+    CHECK(near(roll_for(config, 64), 0.5f * x + 0.5f * x * x * x));
+    CHECK(near(roll_for(config, 127), 1.0f));
+    config.invert = true;
+    CHECK(near(roll_for(config, 127), -1.0f));
+    CHECK(near(roll_for(config, -64), 0.5f * x + 0.5f * x * x * x));
+}
+
+TEST(calibration_follows_the_extremes_seen) {
+    AxisPipeline pipeline;
+    AxisPipeline::AxisConfig config;
+    config.calibrate = true;
+    pipeline.configure(AxisPipeline::Axis_Pitch, config);
+    Clock::time_point t;
+    // starts from a small range, so a short movement is not full scale at once
+    CHECK(near(pipeline.process(sample(t, 0, 16)).value[AxisPipeline::Axis_Pitch], 0.5f));
+    CHECK(near(pipeline.process(sample(t, 0, 64)).value[AxisPipeline::Axis_Pitch], 1.0f));
+    CHECK(near(pipeline.process(sample(t, 0, 32)).value[AxisPipeline::Axis_Pitch], 0.5f));
+    // each side has its own extreme
+    CHECK(near(pipeline.process(sample(t, 0, -16)).value[AxisPipeline::Axis_Pitch], -0.5f));
+    // reset() forgets what was seen
+    pipeline.reset();
+    CHECK(near(pipeline.process(sample(t, 0, 32)).value[AxisPipeline::Axis_Pitch], 1.0f));
+}
+
+TEST(predict_extrapolates_the_rate_up_to_the_horizon) {
+    AxisPipeline pipeline;
+    AxisPipeline::AxisConfig config;
+    config.alpha = 1.0f;
+    config.beta = 1.0f;
+    pipeline.configure(AxisPipeline::Axis_Yaw, config);
+    Clock::time_point t = Clock::time_point() + 1s;
+    pipeline.process(sample(t, 0, 0, 0));
+    const AxisPipeline::Output &output = pipeline.process(sample(t + 10ms, 0, 0, 13));
+    float value = 13.0f / 127;
+    CHECK(near(output.value[AxisPipeline::Axis_Yaw], value));
+    CHECK(std::fabs(output.rate[AxisPipeline::Axis_Yaw] - value / 0.01f) < 1e-2f);
+
+    float values[AxisPipeline::AXES];
+    pipeline.predict(t + 15ms, values);
+    CHECK(near(values[AxisPipeline::Axis_Yaw], 1.5f * value));
+    CHECK(near(values[AxisPipeline::Axis_Roll], 0.0f));
+    // never backwards in time, and no further than the horizon
+    pipeline.predict(t, values);
+    CHECK(near(values[AxisPipeline::Axis_Yaw], value));
+    pipeline.set_max_prediction(2ms);
+    pipeline.predict(t + 1s, values);
+    CHECK(near(values[AxisPipeline::Axis_Yaw], 1.2f * value));
+    // and within -1 to 1
+    pipeline.set_max_prediction(1s);
+    pipeline.predict(t + 1s, values);
+    CHECK(near(values[AxisPipeline::Axis_Yaw], 1.0f));
+}
+
+TEST(long_gap_restarts_the_filter) {
+    AxisPipeline pipeline;
+    AxisPipeline::AxisConfig config;
+    config.alpha = 0.5f;
+    config.beta = 0.5f;
+    pipeline.configure(AxisPipeline::Axis_Roll, config);
+    Clock::time_point t;
+    pipeline.process(sample(t, 0));
+    pipeline.process(sample(t + 10ms, 64));
+    const AxisPipeline::Output &output = pipeline.process(sample(t + 1s, 127));
+    CHECK(near(output.value[AxisPipeline::Axis_Roll], 1.0f));
+    CHECK(near(output.rate[AxisPipeline::Axis_Roll], 0.0f));
+}
+
+int main() {
+    return run_tests();
+}
@@ -0,0 +1,135 @@
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include <FS200AC/FS200ACCapture.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+
+#include "Check.hpp"
+#include "FS200ACProtocol.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using namespace std::chrono_literals;
+
+static std::string capture_path(const char *test) {
+    std::string path = std::string("/tmp/fs200ac_test_") + test + "_" + std::to_string(getpid()) + ".cap";
+    unlink(path.c_str());
+    return path;
+}
+
+// a record read from the emulator, then another one after gap
+static void capture_two_reads(const char *path, std::chrono::milliseconds gap) {
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port(emulator);
+    CaptureProvider capture(port, path);
+    CHECK(capture.is_open());
+    uint8_t reset[3];
+    make_command(COMMAND_RESET, reset);
+    uint8_t byte;
+    CHECK(capture.write(reset, sizeof(reset)));
+    CHECK(capture.read(&byte, 1));
+    std::this_thread::sleep_for(gap);
+    CHECK(capture.write(reset, sizeof(reset)));
+    CHECK(capture.read(&byte, 1));
+}
+
+TEST(capture_starts_with_a_wall_clock_anchor) {
+    std::string path = capture_path("anchor");
+    auto before = std::chrono::system_clock::now();
+    capture_two_reads(path.c_str(), 0ms);
+    ReplayProvider replay(path.c_str());
+    CHECK(replay.is_open());
+    CHECK(replay.captured_at() >= before - 1s);
+    CHECK(replay.captured_at() <= std::chrono::system_clock::now());
+    uint8_t bytes[2];
+    CHECK(replay.read(bytes, 2));
+    CHECK(replay.finished());
+    unlink(path.c_str());
+}
+
+TEST(realtime_replay_keeps_the_recorded_gaps) {
+    std::string path = capture_path("realtime");
+    capture_two_reads(path.c_str(), 100ms);
+    ReplayProvider replay(path.c_str(), ReplayProvider::Mode_Realtime);
+    replay.setReadTimeout(0, 1000);
+    uint8_t byte;
+    CHECK(replay.read(&byte, 1));
+    auto start = Clock::now();
+    CHECK(replay.read(&byte, 1));
+    auto gap = Clock::now() - start;
+    CHECK(gap >= 90ms);
+    CHECK(gap < 300ms);
+    unlink(path.c_str());
+}
+
+TEST(earlier_captures_replay_but_are_not_appended_to) {
+    std::string path = capture_path("v1");
+    FILE *f = fopen(path.c_str(), "wb");
+    fwrite(CaptureProvider::MAGIC_V1, sizeof(CaptureProvider::MAGIC_V1), 1, f);
+    CaptureProvider::Record record;
+    memset(&record, 0, sizeof(record));
+    record.length = 1;
+    record.direction = CaptureProvider::Direction_Read;
+    const uint8_t banner = 'X';
+    fwrite(&record, sizeof(record), 1, f);
+    fwrite(&banner, 1, 1, f);
+    fclose(f);
+
+    ReplayProvider replay(path.c_str());
+    uint8_t byte = 0;
+    CHECK(replay.read(&byte, 1));
+    CHECK_EQ(byte, 'X');
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port(emulator);
+    CaptureProvider capture(port, path.c_str());
+    CHECK(!capture.is_open());
+    unlink(path.c_str());
+}
+
+TEST(short_read_keeps_what_arrived) {
+    std::string path = capture_path("short");
+    {
+        FS200ACEmulator emulator;
+        FS200ACEmulator::Provider port(emulator);
+        CaptureProvider capture(port, path.c_str());
+        capture.setReadTimeout(0, 50);
+        uint8_t reset[3];
+        make_command(COMMAND_RESET, reset);
+        CHECK(capture.write(reset, sizeof(reset)));
+        // the boot banner, then the reset's acknowledgement and banner
+        uint8_t bytes[4] = {};
+        CHECK(!capture.read(bytes, sizeof(bytes)));
+    }
+    ReplayProvider replay(path.c_str());
+    uint8_t bytes[3] = {};
+    CHECK(replay.read(bytes, 3));
+    CHECK_EQ(bytes[0], CODE_BANNER);
+    CHECK_EQ(bytes[1], CODE_ACKNOWLEDGE);
+    CHECK_EQ(bytes[2], CODE_BANNER);
+    CHECK(replay.finished());
+    unlink(path.c_str());
+}
+
+TEST(replay_view_ends_with_nullptr) {
+    std::string path = capture_path("view");
+    capture_two_reads(path.c_str(), 0ms);
+    ReplayProvider replay(path.c_str());
+    std::size_t count = 0;
+    for (int i = 0; i < 2; i++) {
+        const uint8_t *view = replay.read_view(count);
+        CHECK(view != nullptr);
+        CHECK_EQ(count, 1u);
+    }
+    count = 1;
+    CHECK(replay.read_view(count) == nullptr);
+    CHECK_EQ(count, 0u);
+    uint8_t byte;
+    CHECK_EQ(replay.read_some(&byte, 1), 0u);
+    unlink(path.c_str());
+}
+
+int main() {
+    return run_tests();
+}
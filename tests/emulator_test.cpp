@@ -0,0 +1,340 @@
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/VirtualClock.hpp>
+
+#include "Check.hpp"
+#include "FS200ACProtocol.hpp"
+
+using namespace std::chrono_literals;
+
+// The full protocol against the emulator, in the calling thread. The emulator
+// answers at once, so on virtual time the handshake's pacing and timeouts cost
+// nothing; the clock is stepped by hand between frames where pacing matters.
+struct Rig {
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port;
+    VirtualClock clock;
+    FS200AC fs;
+    FS200AC::ControlsState controls;
+
+    explicit Rig(const FS200ACEmulator::Options &options = synthetic())
+        : emulator(options), port(emulator), fs(port) {
+        fs.set_time_source(&clock);
+        fs.set_resilient(true);
+    }
+
+    static FS200ACEmulator::Options synthetic() {
+        FS200ACEmulator::Options options;
+        options.synthetic = true;
+        return options;
+    }
+
+    bool initialize() { return fs.initialize(controls); }
+    bool initialize(const FS200AC::ConsoleState &state) { return fs.initialize(controls, state); }
+
+    // polls count frames, stepping the clock by step before each; returns the number read
+    int poll(int count, std::chrono::milliseconds step = 0ms) {
+        int read = 0;
+        FS200AC::Sample sample;
+        for (int i = 0; i < count; i++) {
+            clock.advance(step);
+            read += fs.poll(sample.roll, sample.pitch, sample.yaw, sample.event);
+        }
+        return read;
+    }
+};
+
+// the library's defaults with the given baro setting
+static FS200AC::ConsoleState console_state(uint16_t baro) {
+    FS200AC::ConsoleState state = {};
+    state.current_radio = 1;
+    state.nav1_standby_freq = state.nav2_standby_freq = {111, 70};
+    state.nav1_current_freq = state.nav2_current_freq = {109, 50};
+    state.adf_standby_freq = {19, 0};
+    state.adf_current_freq = {20, 0};
+    state.unknown_freq = {118, 90};
+    state.com_freq = {121, 20};
+    state.nav1_course_selector = state.nav2_obs = state.adf_brg = state.autopilot_hdg = 180;
+    state.baro = baro;
+    state.unknown[0] = 1;
+    state.unknown[1] = 2;
+    return state;
+}
+
+TEST(initialize_reads_controls_and_sets_up) {
+    FS200ACEmulator::Options options = Rig::synthetic();
+    options.controls.major_version = 3;
+    options.controls.flaps = 2;
+    Rig rig(options);
+    CHECK(rig.initialize(console_state(3010)));
+    CHECK_EQ(rig.emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(rig.controls.major_version, 3);
+    CHECK_EQ(rig.controls.flaps, 2);
+    CHECK_EQ(rig.emulator.console_state().baro, 3010);
+    CHECK_EQ(rig.fs.last_error(), FS200AC::Error_None);
+    CHECK_EQ(rig.poll(50), 50);
+    CHECK_EQ(rig.emulator.frames_acknowledged(), 50u);
+}
+
+TEST(initialize_again_while_streaming) {
+    Rig rig;
+    CHECK(rig.initialize());
+    CHECK_EQ(rig.poll(10), 10);
+    CHECK(rig.initialize(console_state(2950)));
+    CHECK_EQ(rig.emulator.console_state().baro, 2950);
+    CHECK_EQ(rig.poll(10), 10);
+}
+
+TEST(initialize_records_its_phase_timings) {
+    Rig rig;
+    CHECK(rig.initialize());
+    FS200AC::InitializeTimings timings = rig.fs.initialize_timings();
+    // two paced commands, then the pause before the setup packet
+    CHECK(timings.controls >= 4 * 42ms);
+    CHECK(timings.setup >= 28ms);
+    auto phases = timings.reset + timings.controls + timings.setup;
+    CHECK(timings.total >= phases && timings.total <= phases + 3us);
+    CHECK_EQ(rig.fs.stats().initialize_total.count, 1u);
+    CHECK(rig.initialize());
+    FS200AC::Stats stats = rig.fs.stats();
+    CHECK_EQ(stats.initialize_total.count, 2u);
+    CHECK_EQ(stats.initialize_controls.count, 2u);
+    CHECK((int64_t)stats.initialize_total.max_us >= timings.total.count());
+}
+
+TEST(live_state_follows_the_event_stream) {
+    // idle frames, so only the pushed ones change anything
+    Rig rig((FS200ACEmulator::Options()));
+    CHECK(rig.initialize(console_state(2992)));
+    FS200AC::LiveState live = rig.fs.live_state();
+    CHECK_EQ(live.console.baro, 2992);
+    CHECK_EQ(live.console.current_radio, FS200AC::Radio_NAV1);
+    CHECK_EQ(live.controls.nav1_on, rig.controls.nav1_on);
+    // the frame already on its way when streaming began
+    CHECK_EQ(rig.poll(1), 1);
+    uint64_t version = rig.fs.live_version();
+
+    const uint16_t nav2 = 11385;
+    rig.emulator.push_frame({0, 0, 0, ID_NAV1_ON, {1, 0}});
+    rig.emulator.push_frame({0, 0, 0, ID_FREQ_SELECT_RADIO, {FS200AC::Radio_NAV2, 0}});
+    // the tuning knob sets the selected radio's standby frequency, "use standby" swaps it in
+    rig.emulator.push_frame({0, 0, 0, ID_FREQ_TUNE, {(uint8_t)(nav2 & 0x7f), (uint8_t)(nav2 >> 7)}});
+    rig.emulator.push_frame({0, 0, 0, ID_NAV2_USE_STBY, {0, 0}});
+    rig.emulator.push_frame({0, 0, 0, ID_FREQ_SELECT_RADIO, {FS200AC::Radio_XPNDR, 0}});
+    rig.emulator.push_frame({0, 0, 0, ID_FREQ_TUNE_XPNDR, {2, 100}});
+    rig.emulator.push_frame({5, -6, 7, ID_NONE, {0, 0}});
+    CHECK_EQ(rig.poll(7, 5ms), 7);
+
+    live = rig.fs.live_state();
+    CHECK_EQ(live.controls.nav1_on, 1);
+    CHECK_EQ(live.console.current_radio, FS200AC::Radio_XPNDR);
+    CHECK_EQ(live.console.nav2_current_freq.first, 113);
+    CHECK_EQ(live.console.nav2_current_freq.second, 85);
+    CHECK_EQ(live.console.nav2_standby_freq.first, 109);
+    CHECK_EQ(live.console.nav2_standby_freq.second, 50);
+    CHECK_EQ(live.console.nav1_standby_freq.first, 111);
+    CHECK_EQ(live.xpndr, (2 << 8) | 100);
+    CHECK_EQ(live.roll, 5);
+    CHECK_EQ(live.pitch, -6);
+    CHECK_EQ(live.yaw, 7);
+    CHECK_EQ(live.frames, 8u);
+    CHECK(rig.fs.live_version() != version);
+}
+
+TEST(destructor_resets_the_console) {
+    FS200ACEmulator emulator(Rig::synthetic());
+    FS200ACEmulator::Provider port(emulator);
+    VirtualClock clock;
+    {
+        FS200AC fs(port);
+        fs.set_time_source(&clock);
+        fs.set_resilient(true);
+        FS200AC::ControlsState controls;
+        CHECK(fs.initialize(controls));
+    }
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Idle);
+}
+
+TEST(update_console_goes_out_between_frames) {
+    Rig rig;
+    CHECK(rig.initialize());
+    CHECK(rig.fs.update_console(console_state(3001)));
+    CHECK(rig.fs.console_update_pending());
+    CHECK_EQ(rig.poll(20, 5ms), 20);
+    CHECK(!rig.fs.console_update_pending());
+    CHECK_EQ(rig.emulator.console_state().baro, 3001);
+    FS200AC::Stats stats = rig.fs.stats();
+    CHECK_EQ(stats.console_updates, 1u);
+    CHECK_EQ(stats.console_update_failures, 0u);
+    // the console already has this state
+    CHECK(rig.fs.update_console(console_state(3001)));
+    CHECK_EQ(rig.poll(20, 5ms), 20);
+    CHECK_EQ(rig.fs.stats().console_updates, 1u);
+}
+
+TEST(updates_coalesce_to_the_latest) {
+    Rig rig;
+    CHECK(rig.initialize());
+    for (uint16_t baro = 3000; baro < 3010; baro++) {
+        CHECK(rig.fs.update_console(console_state(baro)));
+    }
+    CHECK_EQ(rig.poll(20, 5ms), 20);
+    CHECK_EQ(rig.emulator.console_state().baro, 3009);
+    CHECK(rig.fs.stats().console_updates <= 2);
+}
+
+TEST(queued_commands_are_paced_by_frames) {
+    Rig rig;
+    CHECK(rig.initialize());
+    uint64_t before = rig.fs.stats().commands;
+    CHECK(rig.fs.queue_command(0x36));
+    CHECK(rig.fs.queue_command(0x36));
+    CHECK_EQ(rig.fs.commands_pending(), 2u);
+    // three bytes each, at least 42 ms apart: not done within the first few frames
+    CHECK_EQ(rig.poll(3, 5ms), 3);
+    CHECK(rig.fs.commands_pending() > 0);
+    CHECK_EQ(rig.poll(100, 5ms), 100);
+    CHECK_EQ(rig.fs.commands_pending(), 0u);
+    FS200AC::Stats stats = rig.fs.stats();
+    CHECK_EQ(stats.commands - before, 2u);
+    CHECK_EQ(stats.command_failures, 0u);
+    CHECK_EQ(rig.emulator.state(), FS200ACEmulator::Streaming);
+}
+
+TEST(update_is_sent_ahead_of_commands) {
+    Rig rig;
+    CHECK(rig.initialize());
+    CHECK(rig.fs.queue_command(0x36));
+    CHECK(rig.fs.update_console(console_state(3005)));
+    // the update goes out in one write after the next frame, well before a paced command completes
+    CHECK_EQ(rig.poll(2, 5ms), 2);
+    CHECK_EQ(rig.emulator.console_state().baro, 3005);
+    CHECK_EQ(rig.poll(100, 5ms), 100);
+    CHECK_EQ(rig.fs.commands_pending(), 0u);
+}
+
+TEST(outbound_refused_before_initialize) {
+    Rig rig;
+    CHECK(!rig.fs.queue_command(0x36));
+    CHECK(!rig.fs.update_console(console_state(3000)));
+    CHECK(!rig.fs.reattach());
+}
+
+TEST(reattach_to_a_console_that_kept_power) {
+    Rig rig;
+    CHECK(rig.initialize(console_state(3002)));
+    CHECK_EQ(rig.poll(10), 10);
+    CHECK(rig.fs.reattach());
+    CHECK_EQ(rig.emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(rig.poll(10), 10);
+}
+
+TEST(reattach_after_a_reboot_restores_the_console_state) {
+    // idle frames, synthetic ones would turn the knobs and change the state to restore
+    Rig rig((FS200ACEmulator::Options()));
+    CHECK(rig.initialize(console_state(3003)));
+    CHECK(rig.fs.update_console(console_state(3004)));
+    CHECK_EQ(rig.poll(10, 5ms), 10);
+    CHECK_EQ(rig.emulator.console_state().baro, 3004);
+    rig.emulator.power_cycle();
+    CHECK_EQ(rig.poll(1), 0);
+    CHECK_EQ(rig.fs.last_error(), FS200AC::Error_Rebooted);
+    CHECK(rig.fs.reattach());
+    CHECK_EQ(rig.emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(rig.emulator.console_state().baro, 3004);
+    CHECK_EQ(rig.poll(10), 10);
+}
+
+TEST(reattach_after_a_silent_reboot) {
+    FS200ACEmulator::Options options;
+    options.boot_banner = false;
+    Rig rig(options);
+    CHECK(rig.initialize(console_state(3006)));
+    CHECK_EQ(rig.poll(10), 10);
+    rig.emulator.power_cycle();
+    CHECK_EQ(rig.poll(1), 0);
+    CHECK_EQ(rig.fs.last_error(), FS200AC::Error_Timeout);
+    CHECK(rig.fs.reattach());
+    CHECK_EQ(rig.emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(rig.emulator.console_state().baro, 3006);
+    CHECK_EQ(rig.poll(10), 10);
+}
+
+// loses the next single-byte write of drop, as a noisy line would
+struct LossyPort : public FS200AC::SerialProvider {
+    FS200ACEmulator::Provider &port;
+    int drop;
+
+    explicit LossyPort(FS200ACEmulator::Provider &port) : port(port), drop(-1) {}
+    virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) { port.setReadTimeout(multiplier, timeout_ms); }
+    virtual void setWriteTimeout(unsigned int multiplier) { port.setWriteTimeout(multiplier); }
+    virtual bool read(uint8_t *buffer, std::size_t count) { return port.read(buffer, count); }
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count) { return port.read_some(buffer, count); }
+    virtual bool write(const uint8_t *buffer, std::size_t count) {
+        if (count == 1 && buffer[0] == drop) {
+            drop = -1;
+            return true;
+        }
+        return port.write(buffer, count);
+    }
+};
+
+TEST(reattach_falls_back_to_initialize_outside_resilient_mode) {
+    FS200ACEmulator::Options options;
+    options.boot_banner = false;
+    FS200ACEmulator emulator(options);
+    FS200ACEmulator::Provider port(emulator);
+    LossyPort lossy(port);
+    VirtualClock clock;
+    FS200AC fs(lossy);
+    fs.set_time_source(&clock);
+    FS200AC::ControlsState controls;
+    CHECK(fs.initialize(controls, console_state(3007)));
+    emulator.power_cycle();
+    // the probe's controls request goes unanswered, which must not assert
+    lossy.drop = 0x36;
+    CHECK(fs.reattach());
+    CHECK_EQ(lossy.drop, -1);
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(emulator.console_state().baro, 3007);
+}
+
+TEST(check_byte_that_looks_like_an_ack_completes_its_command) {
+    FS200ACEmulator::Options options;
+    options.boot_banner = false;
+    FS200ACEmulator emulator(options);
+    FS200ACEmulator::Provider port(emulator);
+    port.setReadTimeout(0, 10);
+    // 0x5c's check byte is 0x06, written byte by byte as send_command() does
+    uint8_t command[3];
+    make_command(0x5c, command);
+    CHECK_EQ(command[2], CODE_ACKNOWLEDGE);
+    for (uint8_t b : command) {
+        CHECK(port.write(&b, 1));
+    }
+    uint8_t reply = 0;
+    CHECK(port.read(&reply, 1));
+    CHECK_EQ(reply, CODE_ACKNOWLEDGE);
+}
+
+TEST(adaptive_pacing_learns_a_shorter_gap) {
+    Rig rig;
+    rig.fs.set_pacing(FS200AC::Pacing_Adaptive);
+    CHECK(rig.initialize());
+    CHECK(rig.fs.command_byte_gap() < 42u);
+}
+
+TEST(adaptive_pacing_backs_off_on_a_slow_console) {
+    FS200ACEmulator::Options options = Rig::synthetic();
+    options.min_byte_gap = 10ms;
+    Rig rig(options);
+    rig.fs.set_pacing(FS200AC::Pacing_Adaptive);
+    // the emulator times byte gaps on the real clock, so this one takes real time
+    rig.fs.set_time_source(nullptr);
+    CHECK(rig.initialize());
+    CHECK(rig.fs.command_byte_gap() >= 10u);
+}
+
+int main() {
+    return run_tests();
+}
@@ -0,0 +1,114 @@
+#include <FS200AC/EventQueue.hpp>
+
+#include "Check.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+static FS200AC::Event knob(FS200AC::Control control, uint16_t value) {
+    FS200AC::Event event = {};
+    event.type = FS200AC::Knob;
+    event.control = control;
+    event.knob = value;
+    return event;
+}
+
+static FS200AC::Event button(FS200AC::Control control) {
+    FS200AC::Event event = {};
+    event.type = FS200AC::Button;
+    event.control = control;
+    return event;
+}
+
+TEST(knobs_keep_their_latest_value) {
+    EventQueue queue;
+    for (uint16_t value = 2990; value < 3000; value++) {
+        CHECK(queue.push(knob(FS200AC::BARO, value), Clock::now()));
+    }
+    CHECK_EQ(queue.size(), 1u);
+    CHECK_EQ(queue.coalesced(), 9u);
+    EventQueue::Entry entry;
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.event.knob, 2999);
+    CHECK_EQ(entry.count, 10u);
+    CHECK(!queue.pop(entry));
+}
+
+TEST(discrete_events_stay_in_order) {
+    EventQueue queue;
+    queue.push(knob(FS200AC::BARO, 1), Clock::now());
+    queue.push(button(FS200AC::RMI), Clock::now());
+    // not merged into the entry ahead of the button
+    queue.push(knob(FS200AC::BARO, 2), Clock::now());
+    CHECK_EQ(queue.size(), 3u);
+    EventQueue::Entry entry;
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.event.knob, 1);
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.event.type, FS200AC::Button);
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.event.knob, 2);
+}
+
+TEST(accumulate_delta_sums_changes) {
+    EventQueue queue;
+    queue.set_policy(FS200AC::Knob, EventQueue::Policy_AccumulateDelta);
+    queue.push(knob(FS200AC::BARO, 100), Clock::now());
+    EventQueue::Entry entry;
+    CHECK(queue.pop(entry));
+    queue.push(knob(FS200AC::BARO, 103), Clock::now());
+    queue.push(knob(FS200AC::BARO, 101), Clock::now());
+    queue.push(knob(FS200AC::BARO, 106), Clock::now());
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.delta, 6);
+    CHECK_EQ(entry.count, 3u);
+}
+
+TEST(full_queue_drops_and_counts) {
+    EventQueue queue(2);
+    CHECK(queue.push(button(FS200AC::RMI), Clock::now()));
+    CHECK(queue.push(button(FS200AC::RMI), Clock::now()));
+    CHECK(!queue.push(button(FS200AC::RMI), Clock::now()));
+    CHECK_EQ(queue.dropped(), 1u);
+    CHECK_EQ(queue.size(), 2u);
+}
+
+TEST(delta_of_a_heading_takes_the_short_way_round) {
+    EventQueue queue;
+    queue.set_policy(FS200AC::Knob, EventQueue::Policy_AccumulateDelta);
+    EventQueue::Entry entry;
+    queue.push(knob(FS200AC::AUTOPILOT_HEADING, 358), Clock::now());
+    CHECK(queue.pop(entry));
+    queue.push(knob(FS200AC::AUTOPILOT_HEADING, 359), Clock::now());
+    queue.push(knob(FS200AC::AUTOPILOT_HEADING, 0), Clock::now());
+    queue.push(knob(FS200AC::AUTOPILOT_HEADING, 2), Clock::now());
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.delta, 4);
+    queue.push(knob(FS200AC::AUTOPILOT_HEADING, 355), Clock::now());
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.delta, -7);
+    // baro does not wrap
+    queue.push(knob(FS200AC::BARO, 3000), Clock::now());
+    queue.push(knob(FS200AC::BARO, 2800), Clock::now());
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.delta, -200);
+}
+
+TEST(dropped_movement_is_not_lost) {
+    EventQueue queue(1);
+    queue.set_policy(FS200AC::Knob, EventQueue::Policy_AccumulateDelta);
+    queue.push(knob(FS200AC::BARO, 100), Clock::now());
+    CHECK(!queue.push(button(FS200AC::RMI), Clock::now()));
+    EventQueue::Entry entry;
+    CHECK(queue.pop(entry));
+    CHECK(queue.push(button(FS200AC::RMI), Clock::now()));
+    // full, and the button keeps the knob from merging into anything
+    CHECK(!queue.push(knob(FS200AC::BARO, 105), Clock::now()));
+    CHECK(queue.pop(entry));
+    CHECK(queue.push(knob(FS200AC::BARO, 107), Clock::now()));
+    CHECK(queue.pop(entry));
+    CHECK_EQ(entry.delta, 7);
+}
+
+int main() {
+    return run_tests();
+}
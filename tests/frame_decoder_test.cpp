@@ -0,0 +1,168 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FS200AC/FS200AC.hpp>
+
+#include "Check.hpp"
+#include "FS200ACProtocol.hpp"
+
+typedef FS200AC::FrameDecoder FrameDecoder;
+
+static std::vector<uint8_t> frame(int8_t roll, int8_t pitch, int8_t yaw, uint8_t id = 0, uint8_t b2 = 0, uint8_t b3 = 0) {
+    uint8_t bytes[9];
+    encode_frame(roll, pitch, yaw, id, b2, b3, bytes);
+    return std::vector<uint8_t>(bytes, bytes + sizeof(bytes));
+}
+
+static std::vector<uint8_t> operator+(std::vector<uint8_t> a, const std::vector<uint8_t> &b) {
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+// runs the whole input through in chunks of chunk bytes, collecting every status but NeedMore
+static std::vector<FrameDecoder::Status> decode_all(FrameDecoder &decoder, const std::vector<uint8_t> &input,
+                                                    std::size_t chunk, std::vector<FrameDecoder::Frame> &frames) {
+    std::vector<FrameDecoder::Status> statuses;
+    for (std::size_t offset = 0; offset < input.size(); offset += chunk) {
+        const uint8_t *pos = input.data() + offset;
+        const uint8_t *end = input.data() + std::min(input.size(), offset + chunk);
+        while (pos != end) {
+            FrameDecoder::Frame frame;
+            FrameDecoder::Status status = decoder.decode(pos, end, frame);
+            if (status == FrameDecoder::FrameReady) {
+                frames.push_back(frame);
+            }
+            if (status != FrameDecoder::NeedMore) {
+                statuses.push_back(status);
+            }
+        }
+    }
+    return statuses;
+}
+
+TEST(decodes_axes_and_event) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    decode_all(decoder, frame(-5, 17, -127, ID_BARO, 0x12, 0x01), 64, frames);
+    CHECK_EQ(frames.size(), 1u);
+    if (frames.size() == 1) {
+        CHECK_EQ(frames[0].roll, -5);
+        CHECK_EQ(frames[0].pitch, 17);
+        CHECK_EQ(frames[0].yaw, -127);
+        CHECK_EQ(frames[0].event.type, FS200AC::Knob);
+        CHECK_EQ(frames[0].event.control, FS200AC::BARO);
+    }
+    CHECK(!decoder.in_frame());
+    CHECK_EQ(decoder.unknown_events(), 0u);
+}
+
+TEST(chunk_size_does_not_matter) {
+    std::vector<uint8_t> input = frame(1, 2, 3) + frame(4, 5, 6) + frame(7, 8, 9);
+    for (std::size_t chunk = 1; chunk <= input.size(); chunk++) {
+        FrameDecoder decoder;
+        std::vector<FrameDecoder::Frame> frames;
+        std::vector<FrameDecoder::Status> statuses = decode_all(decoder, input, chunk, frames);
+        CHECK_EQ(statuses.size(), 3u);
+        CHECK_EQ(frames.size(), 3u);
+        if (frames.size() == 3) {
+            CHECK_EQ(frames[2].roll, 7);
+            CHECK_EQ(frames[2].yaw, 9);
+        }
+    }
+}
+
+TEST(skips_noise_between_frames) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    std::vector<uint8_t> noise = {0x01, 0x7f, 0x22};
+    std::vector<uint8_t> acks = {CODE_ACKNOWLEDGE, CODE_ACKNOWLEDGE};
+    decode_all(decoder, noise + frame(1, 1, 1) + acks + frame(2, 2, 2), 4, frames);
+    CHECK_EQ(frames.size(), 2u);
+    CHECK_EQ(decoder.skipped_bytes(), 3u);
+    CHECK_EQ(decoder.acknowledgements(), 2u);
+    CHECK(!decoder.banner_pending());
+}
+
+TEST(checksum_error_then_resync) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    std::vector<uint8_t> bad = frame(1, 1, 1);
+    bad[8] ^= 0x01;
+    std::vector<FrameDecoder::Status> statuses = decode_all(decoder, bad + frame(2, 2, 2), 64, frames);
+    CHECK_EQ(statuses.size(), 2u);
+    if (statuses.size() == 2) {
+        CHECK_EQ(statuses[0], FrameDecoder::ChecksumError);
+        CHECK_EQ(statuses[1], FrameDecoder::FrameReady);
+    }
+    CHECK_EQ(frames.size(), 1u);
+    if (frames.size() == 1) {
+        CHECK_EQ(frames[0].roll, 2);
+    }
+    CHECK_EQ(decoder.restarts(), 0u);
+}
+
+TEST(restarts_from_start_byte_inside_a_cut_off_frame) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    // the first frame loses its last four bytes, the next one starts in its place
+    std::vector<uint8_t> cut = frame(1, 1, 1);
+    cut.resize(5);
+    std::vector<FrameDecoder::Status> statuses = decode_all(decoder, cut + frame(3, 4, 5), 64, frames);
+    CHECK_EQ(statuses.size(), 2u);
+    if (statuses.size() == 2) {
+        CHECK_EQ(statuses[0], FrameDecoder::ChecksumError);
+        CHECK_EQ(statuses[1], FrameDecoder::FrameReady);
+    }
+    CHECK_EQ(decoder.restarts(), 1u);
+    CHECK_EQ(frames.size(), 1u);
+    if (frames.size() == 1) {
+        CHECK_EQ(frames[0].roll, 3);
+        CHECK_EQ(frames[0].pitch, 4);
+        CHECK_EQ(frames[0].yaw, 5);
+    }
+}
+
+TEST(banner_between_frames_is_reported) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    std::vector<uint8_t> banner = {CODE_BANNER};
+    decode_all(decoder, frame(1, 1, 1) + banner, 64, frames);
+    CHECK_EQ(frames.size(), 1u);
+    CHECK(decoder.banner_pending());
+    decoder.reset();
+    CHECK(!decoder.banner_pending());
+}
+
+TEST(unknown_ids_decode_as_none) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    // 0x4d is also the value of TRIM_DN, which the event must not claim to be
+    decode_all(decoder, frame(0, 0, 0, 0x7e, 1, 1) + frame(0, 0, 0, 0x4d, 1, 1), 64, frames);
+    CHECK_EQ(frames.size(), 2u);
+    for (auto &decoded : frames) {
+        CHECK_EQ(decoded.event.type, FS200AC::None);
+        CHECK_EQ(decoded.event.control, FS200AC::UNKNOWN);
+    }
+    CHECK_EQ(decoder.frame_data()[4], 0x4d);
+    CHECK_EQ(decoder.unknown_events(), 2u);
+    CHECK(std::string(FS200AC::control_name(FS200AC::UNKNOWN)) == "UNKNOWN");
+}
+
+TEST(frame_data_holds_the_last_frame) {
+    FrameDecoder decoder;
+    std::vector<FrameDecoder::Frame> frames;
+    std::vector<uint8_t> input = frame(9, 8, 7, ID_BARO, 3, 1);
+    decode_all(decoder, input, 64, frames);
+    CHECK(memcmp(decoder.frame_data(), input.data() + 1, 8) == 0);
+}
+
+TEST(control_names) {
+    CHECK(strcmp(FS200AC::control_name(FS200AC::BARO), "BARO") == 0);
+    CHECK(FS200AC::control_name((FS200AC::Control)(0x80 | FS200AC::BARO)) == nullptr);
+    CHECK(FS200AC::control_name((FS200AC::Control)0xff) == nullptr);
+}
+
+int main() {
+    return run_tests();
+}
@@ -0,0 +1,95 @@
+#include <vector>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/FrameStream.hpp>
+#include <FS200AC/VirtualClock.hpp>
+
+#include "Check.hpp"
+#include "FS200ACProtocol.hpp"
+
+static_assert(FrameTransport<FS200ACEmulator::Provider>);
+static_assert(FrameTransport<FS200AC::SerialProvider>);
+
+// a console set up by FS200AC and then left streaming for a FrameStream
+static void hand_over(FS200ACEmulator &emulator, FS200ACEmulator::Provider &port) {
+    VirtualClock clock;
+    FS200AC fs(port);
+    fs.set_time_source(&clock);
+    fs.set_reset_on_destroy(false);
+    FS200AC::ControlsState controls;
+    CHECK(fs.initialize(controls));
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Streaming);
+    // long enough for a frame FS200AC left unacknowledged to be sent again
+    port.setReadTimeout(0, 500);
+}
+
+// reads count frames, keeping those that are not idle
+template<typename Stream>
+static std::vector<typename Stream::Frame> read_frames(Stream &stream, int count) {
+    std::vector<typename Stream::Frame> frames;
+    typename Stream::Frame frame;
+    for (int i = 0; i < count && stream.next(frame); i++) {
+        if (frame.roll != 0) {
+            frames.push_back(frame);
+        }
+    }
+    return frames;
+}
+
+static void push_frames(FS200ACEmulator &emulator) {
+    const uint16_t baro = 3012;
+    emulator.push_frame({10, -5, 0, 0, {0, 0}});
+    emulator.push_frame({20, 0, 7, 0, {0, 0}});
+    emulator.push_frame({30, 0, 0, ID_BARO, {(uint8_t)(baro & 0x7f), (uint8_t)(baro >> 7)}});
+}
+
+template<typename Transport>
+static void check_stream(FS200ACEmulator &emulator, Transport &transport) {
+    uint64_t acknowledged = emulator.frames_acknowledged();
+    basic_FrameStream<Transport> stream(transport);
+    auto frames = read_frames(stream, 6);
+    // every frame read was acknowledged, so the emulator moved on each time
+    CHECK_EQ(emulator.frames_acknowledged() - acknowledged, 6u);
+    CHECK_EQ(frames.size(), 3u);
+    if (frames.size() == 3) {
+        CHECK_EQ(frames[0].roll, 10);
+        CHECK_EQ(frames[0].pitch, -5);
+        CHECK_EQ(frames[1].yaw, 7);
+        CHECK_EQ(frames[2].event.type, FS200AC::Knob);
+        CHECK_EQ(frames[2].event.control, FS200AC::BARO);
+        CHECK_EQ(frames[2].event.knob, 3012);
+    }
+    CHECK_EQ(stream.decoder().skipped_bytes(), 0u);
+}
+
+TEST(static_stream_decodes_and_acknowledges) {
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port(emulator);
+    hand_over(emulator, port);
+    push_frames(emulator);
+    check_stream(emulator, port);
+}
+
+TEST(virtual_stream_decodes_and_acknowledges) {
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port(emulator);
+    hand_over(emulator, port);
+    push_frames(emulator);
+    check_stream<FS200AC::SerialProvider>(emulator, port);
+}
+
+TEST(stream_ends_with_the_transport) {
+    FS200ACEmulator emulator;
+    FS200ACEmulator::Provider port(emulator);
+    // idle: nothing to read and nothing coming
+    port.setReadTimeout(0, 10);
+    FrameStream stream(port);
+    FrameStream::Frame frame;
+    CHECK(!stream.next(frame));
+    CHECK_EQ(emulator.frames_acknowledged(), 0u);
+}
+
+int main() {
+    return run_tests();
+}
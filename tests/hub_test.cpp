@@ -0,0 +1,100 @@
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/FS200ACHub.hpp>
+#include <FS200AC/LinuxSerialProvider.hpp>
+
+#include "Check.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::milliseconds;
+using namespace std::chrono_literals;
+
+// consoles on ptys, each emulator served by a thread of its own
+struct Seats {
+    std::vector<std::unique_ptr<FS200ACEmulator>> emulators;
+    std::vector<std::unique_ptr<FS200ACEmulator::PtyServer>> servers;
+    std::vector<std::unique_ptr<LinuxSerialProvider>> ports;
+
+    Seats(std::size_t count, const FS200ACEmulator::Options &options) {
+        for (std::size_t i = 0; i < count; i++) {
+            emulators.emplace_back(new FS200ACEmulator(options));
+            servers.emplace_back(new FS200ACEmulator::PtyServer(*emulators[i]));
+            servers[i]->start();
+            ports.emplace_back(new LinuxSerialProvider(servers[i]->slave_name().c_str()));
+        }
+    }
+};
+
+static bool wait_streaming(FS200ACHub &hub, milliseconds timeout) {
+    auto deadline = Clock::now() + timeout;
+    while (Clock::now() < deadline) {
+        std::size_t streaming = 0;
+        for (std::size_t i = 0; i < hub.size(); i++) {
+            streaming += hub.status(i) == FS200ACHub::Streaming;
+        }
+        if (streaming == hub.size()) {
+            return true;
+        }
+        std::this_thread::sleep_for(5ms);
+    }
+    return false;
+}
+
+TEST(quiet_console_does_not_hold_up_the_others) {
+    const std::size_t count = 4;
+    FS200ACEmulator::Options options;
+    options.synthetic = true;
+    options.frame_rate = 100;
+    // the quiet console just stops, without announcing a reboot
+    options.boot_banner = false;
+    Seats seats(count, options);
+    FS200ACHub hub;
+    for (std::size_t i = 0; i < count; i++) {
+        hub.add_console(*seats.ports[i]);
+    }
+    CHECK(hub.start());
+    CHECK(wait_streaming(hub, 5000ms));
+
+    FS200ACHub::TaggedSample tagged[64];
+    while (hub.pop(tagged, 64)) {
+    }
+    seats.emulators[0]->power_cycle();
+    // A console only sends its next frame once the last one is acknowledged, so
+    // the gap between samples bounds the ACK latency. The quiet console's reads
+    // time out after 100 ms and more, which must not show up here.
+    std::vector<Clock::time_point> last(count, Clock::now());
+    Clock::duration longest_gap(0);
+    std::vector<std::size_t> samples(count, 0);
+    auto end = Clock::now() + 1500ms;
+    while (Clock::now() < end) {
+        std::size_t n = hub.pop(tagged, 64);
+        for (std::size_t i = 0; i < n; i++) {
+            std::size_t console = tagged[i].console;
+            samples[console]++;
+            if (console != 0) {
+                longest_gap = std::max(longest_gap, tagged[i].sample.timestamp - last[console]);
+                last[console] = tagged[i].sample.timestamp;
+            }
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    CHECK(longest_gap < 60ms);
+    for (std::size_t i = 1; i < count; i++) {
+        // 150 frames at 100 Hz
+        CHECK(samples[i] >= 120);
+    }
+    // frames that were already on their way, then nothing
+    CHECK(samples[0] < 5);
+    CHECK_EQ(hub.status(0), FS200ACHub::Streaming);
+    hub.stop();
+    for (std::size_t i = 0; i < count; i++) {
+        CHECK_EQ(hub.status(i), FS200ACHub::Stopped);
+    }
+}
+
+int main() {
+    return run_tests();
+}
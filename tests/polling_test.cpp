@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <array>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/VirtualClock.hpp>
+
+#include "Check.hpp"
+#include "ScriptProvider.hpp"
+
+using std::chrono::milliseconds;
+using namespace std::chrono_literals;
+
+// An FS200AC polling a script on virtual time, with a fixed 100 ms frame timeout.
+// It never went through initialize(), so it must not reset anything on the way out.
+struct Host {
+    VirtualClock clock;
+    ScriptProvider port;
+    FS200AC fs;
+
+    explicit Host(bool resilient = true) : port(clock), fs(port) {
+        fs.set_time_source(&clock);
+        fs.set_resilient(resilient);
+        fs.set_reset_on_destroy(false);
+        FS200AC::Timeouts timeouts = {};
+        timeouts.frame = 100ms;
+        fs.set_timeouts(timeouts);
+    }
+
+    bool poll(FS200AC::Sample &sample) {
+        return fs.poll(sample.roll, sample.pitch, sample.yaw, sample.event);
+    }
+
+    milliseconds elapsed() { return std::chrono::duration_cast<milliseconds>(clock.now().time_since_epoch()); }
+    std::size_t acks() const { return std::count(port.written().begin(), port.written().end(), CODE_ACKNOWLEDGE); }
+};
+
+TEST(frame_is_acknowledged) {
+    Host host;
+    host.port.frame_at(0ms, 1, -2, 3);
+    FS200AC::Sample sample;
+    CHECK(host.poll(sample));
+    CHECK_EQ(sample.roll, 1);
+    CHECK_EQ(sample.pitch, -2);
+    CHECK_EQ(sample.yaw, 3);
+    CHECK_EQ(host.acks(), 1u);
+    CHECK_EQ(host.fs.stats().frames, 1u);
+}
+
+TEST(silence_times_out_at_the_deadline) {
+    Host host;
+    FS200AC::Sample sample;
+    CHECK(!host.poll(sample));
+    CHECK_EQ(host.elapsed().count(), 100);
+    CHECK_EQ(host.fs.last_error(), FS200AC::Error_Timeout);
+    FS200AC::Stats stats = host.fs.stats();
+    CHECK_EQ(stats.frame_timeouts, 1u);
+    CHECK_EQ(stats.partial_frames, 0u);
+    CHECK_EQ(host.acks(), 0u);
+}
+
+TEST(late_frame_within_the_timeout_is_read) {
+    Host host;
+    host.port.frame_at(60ms, 5, 5, 5);
+    FS200AC::Sample sample;
+    CHECK(host.poll(sample));
+    CHECK_EQ(sample.roll, 5);
+    CHECK(host.elapsed() >= 60ms);
+    CHECK(host.elapsed() < 100ms);
+}
+
+TEST(frame_split_across_a_pause_is_kept) {
+    Host host;
+    uint8_t frame[9];
+    encode_frame(7, 7, 7, 0, 0, 0, frame);
+    host.port.at(0ms, frame, 4);
+    host.port.at(80ms, frame + 4, 5);
+    FS200AC::Sample sample;
+    CHECK(host.poll(sample));
+    CHECK_EQ(sample.roll, 7);
+    FS200AC::Stats stats = host.fs.stats();
+    CHECK_EQ(stats.partial_frames, 0u);
+    CHECK_EQ(stats.frame_timeouts, 0u);
+}
+
+TEST(stalled_frame_is_counted_once) {
+    Host host;
+    uint8_t frame[9];
+    encode_frame(7, 7, 7, 0, 0, 0, frame);
+    host.port.at(0ms, frame, 4);
+    FS200AC::Sample sample;
+    CHECK(!host.poll(sample));
+    CHECK_EQ(host.elapsed().count(), 100);
+    CHECK_EQ(host.fs.last_error(), FS200AC::Error_PartialFrame);
+    FS200AC::Stats stats = host.fs.stats();
+    CHECK_EQ(stats.partial_frames, 1u);
+    CHECK_EQ(stats.frame_timeouts, 0u);
+    // resilient mode drops the stale start, the next frame decodes on its own
+    host.port.frame_at(150ms, 8, 8, 8);
+    CHECK(host.poll(sample));
+    CHECK_EQ(sample.roll, 8);
+}
+
+TEST(banner_instead_of_a_frame_is_a_reboot) {
+    Host host;
+    host.port.frame_at(0ms, 1, 1, 1);
+    const uint8_t banner = CODE_BANNER;
+    host.port.at(5ms, &banner, 1);
+    FS200AC::Sample sample;
+    CHECK(host.poll(sample));
+    CHECK(!host.poll(sample));
+    CHECK_EQ(host.fs.last_error(), FS200AC::Error_Rebooted);
+}
+
+TEST(resilient_mode_skips_bad_frames) {
+    Host host;
+    uint8_t bad[9];
+    encode_frame(1, 1, 1, 0, 0, 0, bad);
+    bad[8] ^= 0x10;
+    host.port.at(0ms, bad, sizeof(bad));
+    host.port.frame_at(10ms, 2, 2, 2);
+    FS200AC::Sample sample;
+    CHECK(host.poll(sample));
+    CHECK_EQ(sample.roll, 2);
+    CHECK_EQ(host.fs.stats().checksum_errors, 1u);
+    // only the good frame is acknowledged
+    CHECK_EQ(host.acks(), 1u);
+}
+
+TEST(strict_mode_gives_up_on_a_bad_frame) {
+    Host host(false);
+    uint8_t bad[9];
+    encode_frame(1, 1, 1, 0, 0, 0, bad);
+    bad[8] ^= 0x10;
+    host.port.at(0ms, bad, sizeof(bad));
+    host.port.frame_at(10ms, 2, 2, 2);
+    FS200AC::Sample sample;
+    CHECK(!host.poll(sample));
+    CHECK_EQ(host.fs.last_error(), FS200AC::Error_Checksum);
+    CHECK_EQ(host.acks(), 0u);
+    CHECK(host.poll(sample));
+    CHECK_EQ(sample.roll, 2);
+}
+
+TEST(poll_batch_takes_what_is_buffered) {
+    Host host;
+    for (int i = 0; i < 5; i++) {
+        host.port.frame_at(0ms, (int8_t)i, 0, 0);
+    }
+    host.port.frame_at(50ms, 9, 0, 0);
+    std::array<FS200AC::Sample, 16> samples;
+    std::size_t count = host.fs.poll_batch(samples, host.clock.now() + 100ms);
+    CHECK_EQ(count, 5u);
+    CHECK_EQ(samples[4].roll, 4);
+    CHECK_EQ(host.elapsed().count(), 0);
+    // nothing buffered: waits for the next frame
+    count = host.fs.poll_batch(samples, host.clock.now() + 100ms);
+    CHECK_EQ(count, 1u);
+    CHECK_EQ(samples[0].roll, 9);
+    count = host.fs.poll_batch(samples, host.clock.now() + 100ms);
+    CHECK_EQ(count, 0u);
+    CHECK_EQ(host.fs.last_error(), FS200AC::Error_Timeout);
+}
+
+TEST(timeouts_overrides_and_fallbacks) {
+    Host host;
+    FS200AC::Timeouts timeouts = host.fs.timeouts();
+    CHECK_EQ(timeouts.frame.count(), 100);
+    // no measurements yet, the rest keep their fixed starting values
+    CHECK_EQ(timeouts.command.count(), 500);
+    CHECK_EQ(timeouts.response.count(), 440);
+    FS200AC::Timeouts overrides = {};
+    host.fs.set_timeouts(overrides);
+    CHECK_EQ(host.fs.timeouts().frame.count(), 100);
+}
+
+TEST(frame_timeout_follows_the_measured_turnaround) {
+    Host host;
+    host.fs.set_timeouts(FS200AC::Timeouts());
+    // frames 2 ms after each acknowledgement
+    for (int i = 0; i < 200; i++) {
+        host.port.frame_at(milliseconds(2 * i), 0, 0, 0);
+    }
+    FS200AC::Sample sample;
+    for (int i = 0; i < 200; i++) {
+        CHECK(host.poll(sample));
+    }
+    // twice the 99th percentile plus the margin, kept above the floor
+    CHECK_EQ(host.fs.timeouts().frame.count(), 20);
+}
+
+int main() {
+    return run_tests();
+}
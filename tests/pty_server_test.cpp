@@ -0,0 +1,46 @@
+#include <thread>
+
+#include <FS200AC/FS200AC.hpp>
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/LinuxSerialProvider.hpp>
+
+#include "Check.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(stalled_host_loses_no_bytes) {
+    FS200ACEmulator::Options options;
+    options.synthetic = true;
+    options.boot_banner = false;
+    // an unacknowledged frame goes out again on every pass, filling the pty quickly
+    options.ack_timeout = 0ms;
+    FS200ACEmulator emulator(options);
+    FS200ACEmulator::PtyServer server(emulator);
+    CHECK(server.start());
+    LinuxSerialProvider port(server.slave_name().c_str());
+    CHECK(port.is_open());
+    FS200AC fs(port);
+    fs.set_resilient(true);
+    fs.set_reset_on_destroy(false);
+    FS200AC::ControlsState controls;
+    CHECK(fs.initialize(controls));
+
+    // the host stops reading until the pty is full and the server's writes fail
+    std::this_thread::sleep_for(500ms);
+    // reads through everything that piled up and on into what followed it
+    int frames = 0;
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (std::chrono::steady_clock::now() < deadline) {
+        int8_t roll, pitch, yaw;
+        FS200AC::Event event;
+        frames += fs.poll(roll, pitch, yaw, event);
+    }
+    CHECK(frames > 1000);
+    FS200AC::Stats stats = fs.stats();
+    CHECK_EQ(stats.resync_bytes, 0u);
+    CHECK_EQ(stats.checksum_errors, 0u);
+}
+
+int main() {
+    return run_tests();
+}
@@ -0,0 +1,143 @@
+#include <cerrno>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <FS200AC/FS200ACSharedMemory.hpp>
+
+#include "Check.hpp"
+
+static std::string object_name(const char *test) {
+    return std::string("/fs200ac_test_") + test + "_" + std::to_string(getpid());
+}
+
+static FS200AC::Sample sample(int8_t roll) {
+    FS200AC::Sample sample = {};
+    sample.roll = roll;
+    return sample;
+}
+
+TEST(subscriber_reads_in_order) {
+    std::string name = object_name("order");
+    SharedMemoryPublisher publisher(name.c_str(), 8);
+    CHECK(publisher.is_open());
+    SharedMemorySubscriber subscriber(name.c_str());
+    CHECK(subscriber.is_open());
+    FS200AC::Sample out;
+    CHECK(!subscriber.pop(out));
+    for (int i = 0; i < 5; i++) {
+        publisher.publish(sample((int8_t)i));
+    }
+    for (int i = 0; i < 5; i++) {
+        CHECK(subscriber.pop(out));
+        CHECK_EQ(out.roll, i);
+    }
+    CHECK(!subscriber.pop(out));
+    CHECK_EQ(subscriber.lost(), 0u);
+}
+
+TEST(lapped_subscriber_counts_what_it_lost) {
+    std::string name = object_name("lapped");
+    // rounded up to 4
+    SharedMemoryPublisher publisher(name.c_str(), 3);
+    SharedMemorySubscriber subscriber(name.c_str());
+    for (int i = 0; i < 10; i++) {
+        publisher.publish(sample((int8_t)i));
+    }
+    FS200AC::Sample out[16];
+    std::size_t count = subscriber.pop(out, 16);
+    CHECK_EQ(count, 4u);
+    CHECK_EQ(subscriber.lost(), 6u);
+    CHECK_EQ(out[0].roll, 6);
+    CHECK_EQ(out[3].roll, 9);
+    // caught up again: nothing more is lost
+    publisher.publish(sample(10));
+    publisher.publish(sample(11));
+    CHECK_EQ(subscriber.pop(out, 16), 2u);
+    CHECK_EQ(out[1].roll, 11);
+    CHECK_EQ(subscriber.lost(), 6u);
+}
+
+TEST(late_subscriber_starts_at_the_head) {
+    std::string name = object_name("late");
+    SharedMemoryPublisher publisher(name.c_str(), 8);
+    publisher.publish(sample(1));
+    publisher.publish(sample(2));
+    SharedMemorySubscriber subscriber(name.c_str());
+    FS200AC::Sample out;
+    CHECK(!subscriber.pop(out));
+    publisher.publish(sample(3));
+    CHECK(subscriber.pop(out));
+    CHECK_EQ(out.roll, 3);
+    publisher.publish(sample(4));
+    publisher.publish(sample(5));
+    subscriber.seek_latest();
+    CHECK(!subscriber.pop(out));
+    CHECK_EQ(subscriber.lost(), 0u);
+}
+
+TEST(live_state_is_shared) {
+    std::string name = object_name("live");
+    SharedMemoryPublisher publisher(name.c_str(), 8);
+    SharedMemorySubscriber subscriber(name.c_str());
+    FS200AC::LiveState live = {};
+    live.console.baro = 3001;
+    live.frames = 42;
+    uint64_t version = subscriber.live_version();
+    publisher.on_sample(sample(7), live);
+    FS200AC::LiveState read;
+    CHECK(subscriber.live_state(read));
+    CHECK_EQ(read.console.baro, 3001);
+    CHECK_EQ(read.frames, 42u);
+    CHECK(subscriber.live_version() != version);
+    FS200AC::Sample out;
+    CHECK(subscriber.pop(out));
+    CHECK_EQ(out.roll, 7);
+}
+
+TEST(second_publisher_leaves_a_running_one_alone) {
+    std::string name = object_name("taken");
+    SharedMemoryPublisher publisher(name.c_str(), 8);
+    CHECK(publisher.is_open());
+    SharedMemorySubscriber subscriber(name.c_str());
+    SharedMemoryPublisher second(name.c_str(), 16);
+    CHECK(!second.is_open());
+    CHECK_EQ(second.error(), EEXIST);
+    // the first one's subscribers are still attached to it
+    publisher.publish(sample(1));
+    FS200AC::Sample out;
+    CHECK(subscriber.pop(out));
+    CHECK_EQ(out.roll, 1);
+    SharedMemorySubscriber late(name.c_str());
+    CHECK(late.is_open());
+}
+
+TEST(crashed_publisher_is_replaced) {
+    std::string name = object_name("crashed");
+    pid_t child = fork();
+    if (child == 0) {
+        // exits without the destructor, leaving the object behind
+        new SharedMemoryPublisher(name.c_str(), 8);
+        _exit(0);
+    }
+    int status = 0;
+    CHECK_EQ(waitpid(child, &status, 0), child);
+    SharedMemoryPublisher publisher(name.c_str(), 16);
+    CHECK(publisher.is_open());
+    CHECK_EQ(publisher.error(), 0);
+    SharedMemorySubscriber subscriber(name.c_str());
+    publisher.publish(sample(2));
+    FS200AC::Sample out;
+    CHECK(subscriber.pop(out));
+    CHECK_EQ(out.roll, 2);
+}
+
+TEST(missing_object_does_not_open) {
+    SharedMemorySubscriber subscriber(object_name("missing").c_str());
+    CHECK(!subscriber.is_open());
+}
+
+int main() {
+    return run_tests();
+}
@@ -0,0 +1,166 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <FS200AC/FS200ACEmulator.hpp>
+#include <FS200AC/FS200ACSupervisor.hpp>
+
+#include "Check.hpp"
+#include "FS200ACProtocol.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using std::chrono::milliseconds;
+using namespace std::chrono_literals;
+
+// A cable to the emulator that can be pulled and plugged back in. Ports opened
+// before the cable was pulled stay dead, as a re-enumerated USB adapter's would.
+struct Cable {
+    FS200ACEmulator &emulator;
+    std::atomic<bool> plugged;
+    std::atomic<int> generation;
+    std::atomic<int> opens;
+    // commands written byte by byte, as send_command() does
+    std::atomic<int> resets;
+    std::atomic<int> controls_requests;
+
+    explicit Cable(FS200ACEmulator &emulator)
+        : emulator(emulator), plugged(true), generation(0), opens(0), resets(0), controls_requests(0) {}
+
+    void pull() {
+        plugged.store(false);
+        generation.fetch_add(1);
+    }
+    void plug() { plugged.store(true); }
+};
+
+struct CablePort : public FS200AC::SerialProvider {
+    Cable &cable;
+    FS200ACEmulator::Provider port;
+    int generation;
+
+    explicit CablePort(Cable &cable) : cable(cable), port(cable.emulator), generation(cable.generation.load()) {}
+    virtual void setReadTimeout(unsigned int multiplier, unsigned int timeout_ms) { port.setReadTimeout(multiplier, timeout_ms); }
+    virtual void setWriteTimeout(unsigned int multiplier) { port.setWriteTimeout(multiplier); }
+    virtual bool read(uint8_t *buffer, std::size_t count) { return connected() && port.read(buffer, count); }
+    virtual std::size_t read_some(uint8_t *buffer, std::size_t count) {
+        if (!connected()) {
+            std::this_thread::sleep_for(1ms);
+            return 0;
+        }
+        return port.read_some(buffer, count);
+    }
+    virtual bool write(const uint8_t *buffer, std::size_t count) {
+        if (!connected()) {
+            return false;
+        }
+        if (count == 1 && buffer[0] == COMMAND_RESET) {
+            cable.resets.fetch_add(1);
+        } else if (count == 1 && buffer[0] == 0x36) {
+            cable.controls_requests.fetch_add(1);
+        }
+        return port.write(buffer, count);
+    }
+    virtual bool connected() { return cable.plugged.load() && generation == cable.generation.load(); }
+};
+
+static FS200ACSupervisor::ProviderFactory factory(Cable &cable) {
+    return [&cable]() -> std::unique_ptr<FS200AC::SerialProvider> {
+        if (!cable.plugged.load()) {
+            return nullptr;
+        }
+        cable.opens.fetch_add(1);
+        return std::unique_ptr<FS200AC::SerialProvider>(new CablePort(cable));
+    };
+}
+
+template<typename F>
+static bool wait_for(F condition, milliseconds timeout = 3000ms) {
+    auto deadline = Clock::now() + timeout;
+    while (!condition()) {
+        if (Clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(2ms);
+    }
+    return true;
+}
+
+// waits for count more samples, returning the last one
+static bool wait_samples(FS200ACSupervisor &supervisor, std::size_t count, FS200AC::Sample &last) {
+    std::size_t seen = 0;
+    return wait_for([&] {
+        FS200AC::Sample samples[64];
+        std::size_t n = supervisor.pop(samples, 64);
+        if (n) {
+            last = samples[n - 1];
+        }
+        seen += n;
+        return seen >= count;
+    });
+}
+
+static FS200ACEmulator::Options console_options() {
+    FS200ACEmulator::Options options;
+    options.frame_rate = 200;
+    return options;
+}
+
+TEST(kept_power_console_resumes_after_a_reopen_without_a_reset) {
+    FS200ACEmulator emulator(console_options());
+    Cable cable(emulator);
+    FS200ACSupervisor supervisor(factory(cable));
+    CHECK(supervisor.start());
+    FS200AC::Sample sample;
+    CHECK(wait_samples(supervisor, 20, sample));
+    CHECK_EQ(supervisor.status(), FS200ACSupervisor::Streaming);
+    int resets = cable.resets.load();
+    int controls_requests = cable.controls_requests.load();
+
+    cable.pull();
+    CHECK(wait_for([&] { return supervisor.status() == FS200ACSupervisor::Connecting; }));
+    std::this_thread::sleep_for(50ms);
+    cable.plug();
+    CHECK(wait_for([&] { return supervisor.reattaches() == 1; }));
+    CHECK(wait_samples(supervisor, 20, sample));
+    CHECK_EQ(supervisor.reopens(), 1u);
+    CHECK_EQ(cable.opens.load(), 2);
+    // picked up where it left off: no reset and no handshake
+    CHECK_EQ(cable.resets.load(), resets);
+    CHECK_EQ(cable.controls_requests.load(), controls_requests);
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(supervisor.outages().count, 1u);
+    supervisor.stop();
+}
+
+TEST(rebooted_console_gets_the_last_live_state_back) {
+    FS200ACEmulator emulator(console_options());
+    Cable cable(emulator);
+    FS200ACSupervisor supervisor(factory(cable));
+    CHECK(supervisor.start());
+    FS200AC::Sample sample;
+    CHECK(wait_samples(supervisor, 10, sample));
+    // turned on the console since it was set up, only the live state knows
+    const uint16_t baro = 2995;
+    FS200ACEmulator::Frame knob = {0, 0, 0, ID_BARO, {(uint8_t)(baro & 0x7f), (uint8_t)(baro >> 7)}};
+    emulator.push_frame(knob);
+    CHECK(wait_for([&] { return supervisor.live_state().console.baro == baro; }));
+    CHECK(emulator.console_state().baro != baro);
+    int resets = cable.resets.load();
+    int controls_requests = cable.controls_requests.load();
+
+    emulator.power_cycle();
+    CHECK(wait_for([&] { return supervisor.reattaches() == 1; }));
+    CHECK(wait_samples(supervisor, 10, sample));
+    CHECK_EQ(supervisor.reopens(), 0u);
+    // the banner says it rebooted, so it is set up again without a reset
+    CHECK_EQ(cable.resets.load(), resets);
+    CHECK(cable.controls_requests.load() > controls_requests);
+    CHECK_EQ(emulator.state(), FS200ACEmulator::Streaming);
+    CHECK_EQ(emulator.console_state().baro, baro);
+    CHECK_EQ(supervisor.live_state().console.baro, baro);
+    supervisor.stop();
+}
+
+int main() {
+    return run_tests();
+}
@@ -0,0 +1,87 @@
+#include <string>
+#include <thread>
+
+#include <FS200AC/FS200ACTrace.hpp>
+
+#include "Check.hpp"
+
+typedef std::chrono::steady_clock Clock;
+using namespace std::chrono_literals;
+
+// the first raw byte of each line the trace wrote
+static std::string first_bytes(FILE *out) {
+    std::string bytes;
+    rewind(out);
+    char line[256];
+    while (fgets(line, sizeof(line), out)) {
+        std::string text(line);
+        std::size_t at = text.find("read");
+        if (at != std::string::npos) {
+            bytes += (char)std::stoul(text.substr(at + 4), nullptr, 16);
+        }
+    }
+    return bytes;
+}
+
+static void record_on_thread(FS200ACTrace &trace, Clock::time_point timestamp, uint8_t byte) {
+    std::thread([&] { trace.record_bytes(FS200ACTrace::Kind_Read, timestamp, &byte, 1); }).join();
+}
+
+TEST(entries_from_one_thread_are_written_at_once) {
+    FILE *out = tmpfile();
+    FS200ACTrace trace(out);
+    trace.set_kinds(~0u);
+    CHECK(trace.start());
+    const uint8_t bytes[] = {1, 2, 3};
+    for (uint8_t byte : bytes) {
+        trace.record_bytes(FS200ACTrace::Kind_Read, Clock::now(), &byte, 1);
+    }
+    auto deadline = Clock::now() + 1s;
+    while (trace.written() < 3 && Clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    CHECK_EQ(trace.written(), 3u);
+    trace.stop();
+    CHECK(first_bytes(out) == std::string("\x01\x02\x03"));
+    fclose(out);
+}
+
+TEST(late_entry_from_another_thread_stays_in_order) {
+    FILE *out = tmpfile();
+    FS200ACTrace trace(out);
+    trace.set_kinds(~0u);
+    auto start = Clock::now();
+    // both threads have a ring before the formatter runs
+    trace.record_bytes(FS200ACTrace::Kind_Read, start, (const uint8_t*)"\x01", 1);
+    record_on_thread(trace, start, 2);
+    trace.record_bytes(FS200ACTrace::Kind_Read, start + 20ms, (const uint8_t*)"\x04", 1);
+    CHECK(trace.start());
+    // the formatter drains several times while the other thread is behind
+    std::this_thread::sleep_for(50ms);
+    CHECK_EQ(trace.written(), 2u);
+    record_on_thread(trace, start + 10ms, 3);
+    trace.stop();
+    CHECK_EQ(trace.written(), 4u);
+    CHECK(first_bytes(out) == std::string("\x01\x02\x03\x04"));
+    fclose(out);
+}
+
+TEST(quiet_thread_holds_back_only_for_a_while) {
+    FILE *out = tmpfile();
+    FS200ACTrace trace(out);
+    trace.set_kinds(~0u);
+    record_on_thread(trace, Clock::now(), 1);
+    CHECK(trace.start());
+    trace.record_bytes(FS200ACTrace::Kind_Read, Clock::now(), (const uint8_t*)"\x02", 1);
+    auto deadline = Clock::now() + 2s;
+    while (trace.written() < 2 && Clock::now() < deadline) {
+        std::this_thread::sleep_for(5ms);
+    }
+    CHECK_EQ(trace.written(), 2u);
+    trace.stop();
+    fclose(out);
+}
+
+int main() {
+    return run_tests();
+}